@@ -2,11 +2,101 @@
 
 #include <bitset>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <type_traits>
 
+/*!
+	@brief  bitset of at most 128 bits in two words, with the part of std::bitset interface used by Bitboard
+	        bits above _BITS are always kept zero, shifts by constant amounts have no branches after inlining
+*/
+template <int _BITS>
+class Bitset128 {
+	static_assert(_BITS > 0 && _BITS <= 128, "Bitset128 holds at most 128 bits");
+	static const uint64_t LOW_MASK = (_BITS >= 64) ? ~0ULL : ((1ULL << (_BITS % 64)) - 1);
+	static const uint64_t HIGH_MASK = (_BITS <= 64) ? 0ULL : ((_BITS == 128) ? ~0ULL : ((1ULL << (_BITS % 64)) - 1));
+
+  private:
+	uint64_t m_low;
+	uint64_t m_high;
+
+  public:
+	Bitset128() : m_low(0), m_high(0) {}
+
+	inline void reset() { m_low = m_high = 0; }
+	inline void set(int position) {
+		if (position < 64) { m_low |= (1ULL << position); }
+		else { m_high |= (1ULL << (position - 64)); }
+	}
+	inline void reset(int position) {
+		if (position < 64) { m_low &= ~(1ULL << position); }
+		else { m_high &= ~(1ULL << (position - 64)); }
+	}
+	inline bool test(int position) const { return (position < 64) ? ((m_low >> position) & 1) : ((m_high >> (position - 64)) & 1); }
+	inline bool operator[](int position) const { return test(position); }
+	inline int count() const { return __builtin_popcountll(m_low) + __builtin_popcountll(m_high); }
+	inline bool none() const { return (m_low | m_high) == 0; }
+	inline int _Find_first() const {
+		if (m_low) { return __builtin_ctzll(m_low); }
+		if (m_high) { return 64 + __builtin_ctzll(m_high); }
+		return _BITS;
+	}
+
+	inline Bitset128 &operator&=(const Bitset128 &rhs) {
+		m_low &= rhs.m_low;
+		m_high &= rhs.m_high;
+		return *this;
+	}
+	inline Bitset128 &operator|=(const Bitset128 &rhs) {
+		m_low |= rhs.m_low;
+		m_high |= rhs.m_high;
+		return *this;
+	}
+	inline Bitset128 &operator^=(const Bitset128 &rhs) {
+		m_low ^= rhs.m_low;
+		m_high ^= rhs.m_high;
+		return *this;
+	}
+	inline Bitset128 operator~() const {
+		Bitset128 bs;
+		bs.m_low = ~m_low & LOW_MASK;
+		bs.m_high = ~m_high & HIGH_MASK;
+		return bs;
+	}
+	inline Bitset128 operator<<(int shift) const {
+		Bitset128 bs;
+		if (shift == 0) { return *this; }
+		if (shift < 64) {
+			bs.m_low = m_low << shift;
+			bs.m_high = (m_high << shift) | (m_low >> (64 - shift));
+		} else if (shift < 128) {
+			bs.m_high = m_low << (shift - 64);
+		}
+		bs.m_low &= LOW_MASK;
+		bs.m_high &= HIGH_MASK;
+		return bs;
+	}
+	inline Bitset128 operator>>(int shift) const {
+		Bitset128 bs;
+		if (shift == 0) { return *this; }
+		if (shift < 64) {
+			bs.m_low = (m_low >> shift) | (m_high << (64 - shift));
+			bs.m_high = m_high >> shift;
+		} else if (shift < 128) {
+			bs.m_low = m_high >> (shift - 64);
+		}
+		return bs;
+	}
+	inline bool operator==(const Bitset128 &rhs) const { return m_low == rhs.m_low && m_high == rhs.m_high; }
+	inline bool operator!=(const Bitset128 &rhs) const { return !this->operator==(rhs); }
+};
+
+// boards of at most 128 bits (e.g. 9x9 Go) are kept in two words instead of std::bitset
 template <int _BITS, int _BOARD_WIDTH>
 class Bitboard {
+	typedef typename std::conditional<(_BITS <= 128), Bitset128<_BITS>, std::bitset<_BITS>>::type Bitmap;
+
   private:
 	static Bitboard<_BITS, _BOARD_WIDTH> s_upBoundary;
 	static Bitboard<_BITS, _BOARD_WIDTH> s_bottomBoundary;
@@ -16,7 +106,7 @@ class Bitboard {
 	static Bitboard<_BITS, _BOARD_WIDTH> s_edge;
 	static Bitboard<_BITS, _BOARD_WIDTH> s_pass;
 	static bool initialized;
-	std::bitset<_BITS> m_bitmap;
+	Bitmap m_bitmap;
 
   public:
 	Bitboard() { reset(); }
@@ -147,8 +237,9 @@ class Bitboard {
 	}
 	Bitboard<_BITS, _BOARD_WIDTH> floodfill(int pos) {
 		Bitboard bmBlock(pos);
-		while (bmBlock != (bmBlock.dilation() & *this)) {
-			bmBlock = bmBlock.dilation() & *this;
+		Bitboard bmNext;
+		while ((bmNext = bmBlock.dilation() & *this) != bmBlock) {
+			bmBlock = bmNext;
 		}
 		return bmBlock;
 	}
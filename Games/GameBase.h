@@ -135,6 +135,8 @@ public:
 	virtual string getFinalScore() const = 0;
 	virtual Color getColor(int position) const = 0;
 	virtual vector<float> getFeatures(SymmetryType type = SYM_NORMAL) const = 0;
+	virtual void getFeatures(float* pFeatures, SymmetryType type = SYM_NORMAL) const = 0;
+	virtual void getLegalMoveMask(int* pLegalMove, int* pBadMove) const = 0;
 
 	// need to be overwritten static function
 	static int getBoardSize() { return -1; }
@@ -6,24 +6,11 @@ HashKey GoGame::m_twoPassHashKey;
 HashKey GoGame::m_turnHashkey;
 bool GoGame::initialized;
 
-void GoGame::resetCA() {
-	m_vclosedAreas.clear();
-	m_bmclosedAreaUsage.reset();
-	m_closedAreas.reset();
-	m_numLifeStone.first = 0;
-	m_numLifeStone.second = 0;
-	for (int p = 0; p < getBoardSize() * getBoardSize(); ++p) {
-		m_vGrids[p].deleteClosedArea();
-		m_vBlocks[p].deleteClosedArea();
-	}
-	m_bmBenson.first.reset();
-	m_bmBenson.second.reset();
-}
-
 void GoGame::reset() {
 	_Game::reset();
 	m_turnColor = COLOR_BLACK;
 	m_hashKey = 0;
+	m_occupiedKoHashKey = 0;
 	m_stoneBitBoard.first.reset();
 	m_stoneBitBoard.second.reset();
 	m_vStoneBitBoard.clear();
@@ -35,11 +22,24 @@ void GoGame::reset() {
 	}
 	m_hashTable.clear();
 	m_vHash.clear();
-	resetCA();
+	_clearLegalMoveCache();
+	m_vLegalMoveCache.clear();
+	for (int c = 0; c < COLOR_SIZE - 1; ++c) {
+		m_benson.m_bmLife[c].reset();
+		m_benson.m_bDirty[c] = false;
+	}
+	m_vBenson.clear();
+	m_vUndoRecords.clear();
+	m_vUndoBlocks.clear();
 }
 
 void GoGame::play(const GoMove &move) {
 	_Game::play(move);
+	m_vLegalMoveCache.push_back(m_legalMoveCache);
+	_clearLegalMoveCache();
+	m_vBenson.push_back(m_benson);
+	m_vUndoRecords.push_back({m_occupiedKoHashKey, m_bmBlockUsage, static_cast<int>(m_vUndoBlocks.size())});
+	m_bmSavedBlock.reset();
 
 	m_turnColor = AgainstColor(move.getColor());
 	m_hashKey ^= m_turnHashkey;
@@ -49,6 +49,8 @@ void GoGame::play(const GoMove &move) {
 		return;
 	}
 
+	m_benson.m_bDirty[move.getColor() - 1] = true;
+	if (!m_benson.m_bDirty[AgainstColor(move.getColor()) - 1] && isBensonAffectedByMove(move)) { m_benson.m_bDirty[AgainstColor(move.getColor()) - 1] = true; }
 	_setColor(move);
 	m_hashKey ^= m_vGridHash[move.getPosition()][move.getColor() - 1];
 
@@ -65,7 +67,7 @@ void GoGame::play(const GoMove &move) {
 		if (g.getColor() == COLOR_NONE) {
 			bmNbrLiberties.setBitOn(vNbr[i]);
 		} else {
-			GoBlock *b = g.getBlock();
+			GoBlock *b = _getBlock(g);
 			if (g.getColor() == move.getColor()) {
 				if ((b->getGrids() - bmNbrOwnBlocks).empty()) {
 					continue;
@@ -82,6 +84,10 @@ void GoGame::play(const GoMove &move) {
 		}
 	}
 
+	// save all blocks changed by this move for undo
+	for (int i = 0; i < static_cast<int>(vNbrOwnBlocks.size()); ++i) { _saveBlock(vNbrOwnBlocks[i]); }
+	for (int i = 0; i < static_cast<int>(vNbrOppBlocks.size()); ++i) { _saveBlock(vNbrOppBlocks[i]); }
+
 	// handle neighbor own blocks
 	if (bmNbrOwnBlocks.empty()) {
 		// create new blocks
@@ -104,6 +110,7 @@ void GoGame::play(const GoMove &move) {
 		if (b->getLiberties().bitCount() == 0) {
 			m_hashKey ^= b->getHashKey();
 			_removeBlockAndGrids(b);
+			m_benson.m_bDirty[AgainstColor(move.getColor()) - 1] = true;
 		}
 	}
 
@@ -123,113 +130,42 @@ void GoGame::undo() {
 		return;
 	}
 
-	GoMove prevMove = m_vMoves.back();
-	GoBitBoard bmEatenStones;
-	// get eaten stones
-	if (prevMove.getColor() == COLOR_BLACK) {
-		bmEatenStones = m_vStoneBitBoard[m_vMoves.size() - 2].second - m_stoneBitBoard.second - GoBitBoard(getBoardSize() * getBoardSize());
-	} else if (prevMove.getColor() == COLOR_WHITE) {
-		bmEatenStones = m_vStoneBitBoard[m_vMoves.size() - 2].first - m_stoneBitBoard.first - GoBitBoard(getBoardSize() * getBoardSize());
-	}
+	// restore legal moves and Benson life of previous position
+	m_legalMoveCache = m_vLegalMoveCache.back();
+	m_vLegalMoveCache.pop_back();
+	m_benson = m_vBenson.back();
+	m_vBenson.pop_back();
 
-	// restore stone bit board
+	GoMove prevMove = m_vMoves.back();
 	m_vStoneBitBoard.pop_back();
-	m_stoneBitBoard = m_vStoneBitBoard[m_vMoves.size() - 1];
+	m_stoneBitBoard = m_vStoneBitBoard.back();
 	m_vMoves.pop_back();
 	m_turnColor = prevMove.getColor();
 
-	if (prevMove.isPass(getBoardSize())) {
-		m_hashKey ^= m_turnHashkey;
-		m_vHash.pop_back();
-		return;
-	}
-
-	// handle hash
-	m_hashTable.erase(m_hashKey);
-	m_hashKey ^= m_vGridHash[prevMove.getPosition()][prevMove.getColor() - 1];
-
-	// handle eaten stones
-	if (!bmEatenStones.empty()) {
-		// rebuild all eaten blocks
-		GoBitBoard bmEatenStonesMap = bmEatenStones;
-		while (!bmEatenStonesMap.empty()) {
-			int pos = bmEatenStonesMap.bitScanForward();
-			GoBitBoard bmEatenBlock = bmEatenStones.floodfill(pos);
-			GoBlock *b = _newBlock(AgainstColor(prevMove.getColor()));
-			_addGridsAndLibertiesToBlock(bmEatenBlock, b, GoBitBoard(prevMove.getPosition()));
-			bmEatenStonesMap -= bmEatenBlock;
-			m_hashKey ^= b->getHashKey();
-		}
+	if (!prevMove.isPass(getBoardSize())) {
+		m_hashTable.erase(m_hashKey);
 
-		// remove liberties of boundary own blocks
-		GoBitBoard bmBoundaryOwnGrids = bmEatenStones.dilation() - bmEatenStones - GoBitBoard(prevMove.getPosition());
-		int pos;
-		while ((pos = bmBoundaryOwnGrids.bitScanForward()) != -1) {
-			GoBlock *blNbrOwnBlock = m_vGrids[pos].getBlock();
-			GoBitBoard bmRmLiberties = blNbrOwnBlock->getGrids().dilation() & bmEatenStones;
-			bmBoundaryOwnGrids -= blNbrOwnBlock->getGrids();
-			blNbrOwnBlock->removeLiberties(bmRmLiberties);
-		}
-	}
-
-	m_hashKey ^= m_turnHashkey;
-	const vector<int> &vNbr = m_vGrids[prevMove.getPosition()].getNeighbors();
-
-	GoBitBoard bmNbrOwnBlocks;
-	GoBitBoard bmNbrOppBlocks;
-
-	// handle neighbor blocks
-	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
-		GoGrid &g = m_vGrids[vNbr[i]];
-		if (g.getColor() != COLOR_NONE) {
-			GoBlock *b = g.getBlock();
-			if (g.getColor() == prevMove.getColor()) {
-				// handle own block
-				GoBitBoard bmBlocksMap = b->getGrids();
-				bmBlocksMap.setBitOff(prevMove.getPosition());
-				// dilate from vNbr[i], check if the block is able to split to two blocks
-				GoBitBoard bmBlock = bmBlocksMap.floodfill(vNbr[i]);
-
-				if ((bmBlock - bmNbrOwnBlocks).empty()) {
-					continue;
-				}
-				bmNbrOwnBlocks |= bmBlock;
-
-				if (bmBlock == bmBlocksMap) {
-					// need not split
-					b->removeGridOnBoundary(prevMove.getPosition(), m_vGridHash[prevMove.getPosition()][prevMove.getColor() - 1]);
-				} else {
-					// need split
-					// create new block
-					GoBitBoard bmNewGrids = bmBlock, bmNewLiberties = (bmBlock.dilation() & b->getLiberties()) | GoBitBoard(prevMove.getPosition());
-					GoBlock *blNewBlock = _newBlock(prevMove.getColor());
-					_addGridsAndLibertiesToBlock(bmNewGrids, blNewBlock, bmNewLiberties);
-
-					// remove from origin block b
-					b->removeGrids(bmNewGrids, blNewBlock->getHashKey());
-				}
-
-			} else {
-				// handle opp block
-				b->addLiberty(prevMove.getPosition());
-				if ((b->getGrids() - bmNbrOppBlocks).empty()) {
-					continue;
-				}
-				bmNbrOppBlocks |= b->getGrids();
+		// write back the blocks before the move, and link their grids again
+		const UndoRecord &record = m_vUndoRecords.back();
+		_setColor(GoMove(COLOR_NONE, prevMove.getPosition()));
+		for (int i = record.m_blockStart; i < static_cast<int>(m_vUndoBlocks.size()); ++i) {
+			const GoBlock &block = m_vUndoBlocks[i];
+			m_vBlocks[block.getIndex()] = block;
+			GoBitBoard bmGrid = block.getGrids();
+			int pos;
+			while ((pos = bmGrid.bitScanForward()) != -1) {
+				m_vGrids[pos].setColor(block.getColor());
+				m_vGrids[pos].setBlockIndex(block.getIndex());
 			}
 		}
+		m_vUndoBlocks.erase(m_vUndoBlocks.begin() + record.m_blockStart, m_vUndoBlocks.end());
+		m_bmBlockUsage = record.m_bmBlockUsage;
+		m_occupiedKoHashKey = record.m_occupiedKoHashKey;
 	}
+	m_vUndoRecords.pop_back();
 
-	if (bmNbrOwnBlocks.empty()) {
-		// prevMove is a block, remove it
-		GoBlock *b = m_vGrids[prevMove.getPosition()].getBlock();
-		_removeBlock(b);
-	}
-
-	_setColor(GoMove(COLOR_NONE, prevMove.getPosition()));
-	// check
-	assert(("Hash restore correctly", m_vHash[m_vMoves.size() - 1] == m_hashKey));
 	m_vHash.pop_back();
+	m_hashKey = m_vHash.back();
 	// deepCheck();
 }
 
@@ -237,36 +173,36 @@ void GoGame::deepCheck() {
 	for (int p = 0; p < getBoardSize() * getBoardSize(); ++p) {
 		if (m_vGrids[p].getColor() == COLOR_BLACK) {
 			assert(("invalid black grid", m_stoneBitBoard.first.BitIsOn(p) && !m_stoneBitBoard.second.BitIsOn(p)));
-			GoBitBoard bm = m_vGrids[p].getBlock()->getGrids();
-			GoBitBoard lib = m_vGrids[p].getBlock()->getLiberties();
+			GoBitBoard bm = _getBlock(m_vGrids[p])->getGrids();
+			GoBitBoard lib = _getBlock(m_vGrids[p])->getLiberties();
 			int pos;
 			HashKey h = 0;
 			while ((pos = bm.bitScanForward()) != -1) {
 				assert(("invalid black block", m_stoneBitBoard.first.BitIsOn(pos) && !m_stoneBitBoard.second.BitIsOn(pos) && m_vGrids[pos].getColor() == COLOR_BLACK));
 				h ^= m_vGridHash[pos][COLOR_BLACK - 1];
 			}
-			assert(("invalid black block hash", h == m_vGrids[p].getBlock()->getHashKey()));
+			assert(("invalid black block hash", h == _getBlock(m_vGrids[p])->getHashKey()));
 			while ((pos = lib.bitScanForward()) != -1) {
 				assert(("invalid black block liberties", !m_stoneBitBoard.first.BitIsOn(pos) && !m_stoneBitBoard.second.BitIsOn(pos) && m_vGrids[pos].getColor() == COLOR_NONE));
 			}
 		}
 		if (m_vGrids[p].getColor() == COLOR_WHITE) {
 			assert(("invalid white grid", !m_stoneBitBoard.first.BitIsOn(p) && m_stoneBitBoard.second.BitIsOn(p)));
-			GoBitBoard bm = m_vGrids[p].getBlock()->getGrids();
-			GoBitBoard lib = m_vGrids[p].getBlock()->getLiberties();
+			GoBitBoard bm = _getBlock(m_vGrids[p])->getGrids();
+			GoBitBoard lib = _getBlock(m_vGrids[p])->getLiberties();
 			int pos;
 			HashKey h = 0;
 			while ((pos = bm.bitScanForward()) != -1) {
 				assert(("invalid white block", !m_stoneBitBoard.first.BitIsOn(pos) && m_stoneBitBoard.second.BitIsOn(pos) && m_vGrids[pos].getColor() == COLOR_WHITE));
 				h ^= m_vGridHash[pos][COLOR_WHITE - 1];
 			}
-			assert(("invalid white block hash", h == m_vGrids[p].getBlock()->getHashKey()));
+			assert(("invalid white block hash", h == _getBlock(m_vGrids[p])->getHashKey()));
 			while ((pos = lib.bitScanForward()) != -1) {
 				assert(("invalid white block liberties", !m_stoneBitBoard.first.BitIsOn(pos) && !m_stoneBitBoard.second.BitIsOn(pos) && m_vGrids[pos].getColor() == COLOR_NONE));
 			}
 		}
 		if (m_vGrids[p].getColor() == COLOR_NONE) {
-			assert(("invalid grid", !m_stoneBitBoard.first.BitIsOn(p) && !m_stoneBitBoard.second.BitIsOn(p) && !m_vGrids[p].getBlock()));
+			assert(("invalid grid", !m_stoneBitBoard.first.BitIsOn(p) && !m_stoneBitBoard.second.BitIsOn(p) && !_getBlock(m_vGrids[p])));
 		}
 	}
 }
@@ -276,6 +212,7 @@ void GoGame::trivialUndo() {
 	//  reset without reset m_vMoves and m_vComments
 	m_turnColor = COLOR_BLACK;
 	m_hashKey = 0;
+	m_occupiedKoHashKey = 0;
 	m_stoneBitBoard.first.reset();
 	m_stoneBitBoard.second.reset();
 	m_vStoneBitBoard.clear();
@@ -286,6 +223,15 @@ void GoGame::trivialUndo() {
 		m_vBlocks[i].clear();
 	}
 	m_hashTable.clear();
+	_clearLegalMoveCache();
+	m_vLegalMoveCache.clear();
+	for (int c = 0; c < COLOR_SIZE - 1; ++c) {
+		m_benson.m_bmLife[c].reset();
+		m_benson.m_bDirty[c] = false;
+	}
+	m_vBenson.clear();
+	m_vUndoRecords.clear();
+	m_vUndoBlocks.clear();
 	m_vMoves.pop_back();
 	auto moves = m_vMoves;
 	m_vMoves.clear();
@@ -313,7 +259,21 @@ bool GoGame::isLastMoveCaptureBlock() const
 	return bmStone.bitCount() <= bmPrevStone.bitCount();
 }
 
-bool GoGame::isLegalMove(const GoMove &move) const {
+const GoBitBoard& GoGame::getLegalBitBoard(Color c) const {
+	assert(("Invalid move color", c == COLOR_BLACK || c == COLOR_WHITE));
+
+	LegalMoveCache& cache = m_legalMoveCache;
+	if (!cache.m_bComputed[c - 1]) {
+		cache.m_bmLegal[c - 1].reset();
+		for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
+			if (_isLegalMove(GoMove(c, pos))) { cache.m_bmLegal[c - 1].setBitOn(pos); }
+		}
+		cache.m_bComputed[c - 1] = true;
+	}
+	return cache.m_bmLegal[c - 1];
+}
+
+bool GoGame::_isLegalMove(const GoMove &move) const {
 	assert(("Invalid move color", move.getColor() == COLOR_BLACK || move.getColor() == COLOR_WHITE));
 	assert(("Invalid move position", move.getPosition() >= 0 && move.getPosition() < getMaxNumLegalAction()));
 
@@ -333,7 +293,8 @@ bool GoGame::isLegalMove(const GoMove &move) const {
 
 	HashKey key = 0;
 	bool bLegal = false;
-	unordered_set<int> checkedBlockID;
+	int nCheckedBlock = 0;
+	int checkedBlockID[4];
 	const vector<int> &vNbr = m_vGrids[pos].getNeighbors();
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
 		const GoGrid &g = m_vGrids[vNbr[i]];
@@ -341,10 +302,10 @@ bool GoGame::isLegalMove(const GoMove &move) const {
 			bLegal = true;
 		}
 		else {
-			const GoBlock *b = g.getBlock();
-			if(checkedBlockID.count(b->getIndex())) { continue; }
+			const GoBlock *b = _getBlock(g);
+			if (find(checkedBlockID, checkedBlockID + nCheckedBlock, b->getIndex()) != checkedBlockID + nCheckedBlock) { continue; }
 
-			checkedBlockID.insert(b->getIndex());
+			checkedBlockID[nCheckedBlock++] = b->getIndex();
 			if (g.getColor() == move.getColor()) {
 				if (b->getLiberties().bitCount() > 1) {
 					bLegal = true;
@@ -362,7 +323,7 @@ bool GoGame::isLegalMove(const GoMove &move) const {
 	//check forbidden move
 #ifdef GO
 	if (GameConfigure::GO_FORBIDDEN_OWN_TRUE_EYE && isOwnTrueEye(move)) { bLegal = false; }
-	if (GameConfigure::GO_FORBIDDEN_BENSON_REGION && (m_bmBenson.first | m_bmBenson.second).BitIsOn(move.getPosition())) { bLegal = false; }
+	if (GameConfigure::GO_FORBIDDEN_BENSON_REGION && (m_benson.m_bmLife[0] | m_benson.m_bmLife[1]).BitIsOn(move.getPosition())) { bLegal = false; }
 	if (GameConfigure::GO_BLACK_FORBIDDEN_EAT_KO && move.getColor() == COLOR_BLACK && isEatKoMove(move)) { bLegal = false; }
 	if (GameConfigure::GO_WHITE_FORBIDDEN_EAT_KO && move.getColor() == COLOR_WHITE && isEatKoMove(move)) { bLegal = false; }
 #endif
@@ -375,19 +336,13 @@ bool GoGame::isBadMove(const GoMove &move) const {
 }
 
 bool GoGame::isTerminal() {
-	resetCA();
-	findFullBoardUCTClosedArea();
-	if (m_bmBenson.second.bitCount() > 0) {
+	updateBensonLife();
+	if (!getBensonBitboard(COLOR_WHITE).empty()) {
 		// White Benson
 		return true;
 	}
 
-	GoBitBoard bmBValid, bmWValid;
-	for (int pos = 0; pos < MAX_NUM_MOVES; ++pos) {
-		if (isLegalMove(GoMove(COLOR_BLACK, pos))) bmBValid.setBitOn(pos);
-		if (isLegalMove(GoMove(COLOR_WHITE, pos))) bmWValid.setBitOn(pos);
-	}
-	if (bmBValid.empty() && bmWValid.empty()) {
+	if (getLegalBitBoard(COLOR_BLACK).empty() && getLegalBitBoard(COLOR_WHITE).empty()) {
 		// no valid move
 		return true;
 	}
@@ -402,16 +357,12 @@ bool GoGame::isTerminal() {
 Color GoGame::eval() const {
 	// White win if two pass but white exist stones
 	if (m_vMoves.size() >= 2 && m_vMoves[m_vMoves.size() - 1].isPass(getBoardSize()) && m_vMoves[m_vMoves.size() - 2].isPass(getBoardSize())) {
-		for (int pos = 0; pos < NUM_GRIDS; ++pos) {
-			if (isLegalMove(GoMove(COLOR_BLACK, pos))) {
-				return COLOR_WHITE;
-			}
-		}
+		if (!(getLegalBitBoard(COLOR_BLACK) - GoBitBoard::getPassBitBoard()).empty()) { return COLOR_WHITE; }
 		return m_stoneBitBoard.second.empty() ? COLOR_BLACK : COLOR_WHITE;
 	}
 
 	// Benson
-	return m_bmBenson.second.empty() ? COLOR_BLACK : COLOR_WHITE;
+	return getBensonBitboard(COLOR_WHITE).empty() ? COLOR_BLACK : COLOR_WHITE;
 }
 
 string GoGame::getFinalScore() const {
@@ -423,40 +374,55 @@ Color GoGame::getColor(int position) const {
 }
 
 vector<float> GoGame::getFeatures(SymmetryType type /* = SYM_NORMAL*/) const {
-	vector<float> vFeatures;
+	vector<float> vFeatures(getNumChannels() * (getMaxNumLegalAction() - 1));
+	getFeatures(vFeatures.data(), type);
+	return vFeatures;
+}
+
+void GoGame::getFeatures(float* pFeatures, SymmetryType type /* = SYM_NORMAL*/) const {
+	// write features directly into pFeatures (e.g. the input buffer of network)
 	for (int channel = 0; channel < getNumChannels(); ++channel) {
 		for (int pos = 0; pos < getMaxNumLegalAction() - 1; ++pos) {
 			int rotatePos = getRotatePosition(pos, getBoardSize(), ReverseSymmetricType[type]);
 			if (channel < 16) {
 				int lastN = m_vMoves.size() - 1 - channel / 2;
 				if (lastN < 0) {
-					vFeatures.push_back(0.0f);
+					*pFeatures++ = 0.0f;
 				} else {
 					const pair<GoBitBoard, GoBitBoard> &bitBoard = m_vStoneBitBoard[lastN];
 					if (channel % 2 == 0) {
-						vFeatures.push_back(bitBoard.first.BitIsOn(rotatePos) == true ? 1.0f : 0.0f);
+						*pFeatures++ = (bitBoard.first.BitIsOn(rotatePos) == true ? 1.0f : 0.0f);
 					} else {
-						vFeatures.push_back(bitBoard.second.BitIsOn(rotatePos) == true ? 1.0f : 0.0f);
+						*pFeatures++ = (bitBoard.second.BitIsOn(rotatePos) == true ? 1.0f : 0.0f);
 					}
 				}
 			} else if (channel == 16) {
-				vFeatures.push_back((m_turnColor == COLOR_BLACK ? 1.0f : 0.0f));
+				*pFeatures++ = (m_turnColor == COLOR_BLACK ? 1.0f : 0.0f);
 			} else if (channel == 17) {
-				vFeatures.push_back((m_turnColor == COLOR_WHITE ? 1.0f : 0.0f));
+				*pFeatures++ = (m_turnColor == COLOR_WHITE ? 1.0f : 0.0f);
 			}
 		}
 	}
-	return vFeatures;
+}
+
+void GoGame::getLegalMoveMask(int* pLegalMove, int* pBadMove) const {
+	const GoBitBoard& bmLegal = getLegalBitBoard(m_turnColor);
+	for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
+		pLegalMove[pos] = bmLegal.BitIsOn(pos);
+		pBadMove[pos] = isBadMove(GoMove(m_turnColor, pos));
+	}
 }
 
 HashKey GoGame::getTTHashKey() const {
 	HashKey ttHashkey = m_hashKey;
-	for (int pos = 0; pos < getBoardSize() * getBoardSize(); ++pos) {
-		GoMove move(m_turnColor, pos);
-		if (isLegalMove(move)) { continue; }
-
-		ttHashkey ^= m_vKoHash[pos];
+	GoBitBoard bmIllegal = ~getLegalBitBoard(m_turnColor) - GoBitBoard::getPassBitBoard();
+	if (m_mForceMoves.find(m_vMoves.size() + 1) == m_mForceMoves.end()) {
+		// occupied points are always illegal except the force move
+		ttHashkey ^= m_occupiedKoHashKey;
+		bmIllegal -= (m_stoneBitBoard.first | m_stoneBitBoard.second);
 	}
+	int pos;
+	while ((pos = bmIllegal.bitScanForward()) != -1) { ttHashkey ^= m_vKoHash[pos]; }
 
 	if (m_vMoves.size() >= 2) {
 		if (m_vMoves[m_vMoves.size() - 1].isPass(getBoardSize()) && m_vMoves[m_vMoves.size() - 2].isPass(getBoardSize())) {
@@ -488,6 +454,7 @@ void GoGame::_initialize() {
 void GoGame::_setColor(const GoMove &move) {
 	const int pos = move.getPosition();
 	const Color c = move.getColor();
+	if ((m_vGrids[pos].getColor() == COLOR_NONE) != (c == COLOR_NONE)) { m_occupiedKoHashKey ^= m_vKoHash[pos]; }
 	m_vGrids[pos].setColor(c);
 	if (c == COLOR_BLACK) {
 		m_stoneBitBoard.first.setBitOn(pos);
@@ -496,13 +463,14 @@ void GoGame::_setColor(const GoMove &move) {
 	} else {
 		m_stoneBitBoard.first.setBitOff(pos);
 		m_stoneBitBoard.second.setBitOff(pos);
-		m_vGrids[pos].setBlock(nullptr);
+		m_vGrids[pos].setBlockIndex(-1);
 	}
 }
 
 GoBlock *GoGame::_newBlock(Color c) {
 	const int index = m_bmBlockUsage.bitScanForward();
 	GoBlock *b = &m_vBlocks[index];
+	_saveBlock(b);
 	b->setColor(c);
 
 	return b;
@@ -524,7 +492,8 @@ void GoGame::_removeBlockAndGrids(GoBlock *b) {
 			if (nbrGrid.getColor() != AgainstColor(b->getColor())) {
 				continue;
 			}
-			nbrGrid.getBlock()->getLiberties().setBitOn(pos);
+			_saveBlock(_getBlock(nbrGrid));
+			_getBlock(nbrGrid)->getLiberties().setBitOn(pos);
 		}
 	}
 	_removeBlock(b);
@@ -533,25 +502,13 @@ void GoGame::_removeBlockAndGrids(GoBlock *b) {
 void GoGame::_addGridAndLibertiesToBlock(GoMove m, GoBlock *b, const GoBitBoard &bmNbrLiberties) {
 	const int pos = m.getPosition();
 	b->addGrid(pos);
-	m_vGrids[pos].setBlock(b);
+	m_vGrids[pos].setBlockIndex(b->getIndex());
 	b->addLiberties(bmNbrLiberties);
 	if (m.getColor() != COLOR_NONE) {
 		b->addHashKey(m_vGridHash[m.getPosition()][m.getColor() - 1]);
 	}
 }
 
-void GoGame::_addGridsAndLibertiesToBlock(GoBitBoard &bmGrids, GoBlock *b, const GoBitBoard &bmNbrLiberties) {
-	b->addGrids(bmGrids);
-	b->addLiberties(bmNbrLiberties);
-	GoBitBoard bmGrid = bmGrids;
-	int pos;
-	while ((pos = bmGrid.bitScanForward()) != -1) {
-		m_vGrids[pos].setBlock(b);
-		_setColor(GoMove(b->getColor(), pos));
-		b->addHashKey(m_vGridHash[pos][b->getColor() - 1]);
-	}
-}
-
 GoBlock *GoGame::_combineBlocks(GoBlock *b1, GoBlock *b2) {
 	if (b1->getGrids().bitCount() < b2->getGrids().bitCount()) {
 		return _combineBlocks(b2, b1);
@@ -561,7 +518,7 @@ GoBlock *GoGame::_combineBlocks(GoBlock *b1, GoBlock *b2) {
 	int pos;
 	GoBitBoard bmGrid = b2->getGrids();
 	while ((pos = bmGrid.bitScanForward()) != -1) {
-		m_vGrids[pos].setBlock(b1);
+		m_vGrids[pos].setBlockIndex(b1->getIndex());
 	}
 	_removeBlock(b2);
 
@@ -582,7 +539,7 @@ GoBitBoard GoGame::getStoneBitBoardAfterPlay(const GoMove &move) const
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
 		const GoGrid& nbrGrid = m_vGrids[vNbr[i]];
 		if (nbrGrid.getColor() == myColor) {
-			bmStoneAfterPlay |= nbrGrid.getBlock()->getGrids();
+			bmStoneAfterPlay |= _getBlock(nbrGrid)->getGrids();
 		}
 	}
 	bmStoneAfterPlay.setBitOn(move.getPosition());
@@ -610,11 +567,11 @@ GoBitBoard GoGame::getLibertyBitBoardAfterPlay(const GoMove &move) const
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
 		const GoGrid& nbrGrid = m_vGrids[vNbr[i]];
 		if (nbrGrid.getColor() == myColor) {
-			bmNewLib |= nbrGrid.getBlock()->getStonenNbrMap();
+			bmNewLib |= _getBlock(nbrGrid)->getStonenNbrMap();
 		}
 		else if (nbrGrid.getColor() == oppColor) {
-			if (nbrGrid.getBlock()->getLiberties() == 1) {
-				bmExclude -= nbrGrid.getBlock()->getGrids();
+			if (_getBlock(nbrGrid)->getLiberties() == 1) {
+				bmExclude -= _getBlock(nbrGrid)->getGrids();
 			}
 		}
 	}
@@ -641,7 +598,7 @@ void GoGame::getMoveInfluence(const GoMove &move, pair<GoBitBoard, GoBitBoard>&
 			const GoGrid& nbrGrid = m_vGrids[vNbr[i]];
 			if (nbrGrid.getColor() != oppColor) { continue; }
 
-			const GoBlock* nbrBlock = nbrGrid.getBlock();
+			const GoBlock* nbrBlock = _getBlock(nbrGrid);
 			if (nbrBlock->getNumLiberty() == 1) { bmDeadStone |= nbrBlock->getGrids();}
 		}
 
@@ -649,7 +606,7 @@ void GoGame::getMoveInfluence(const GoMove &move, pair<GoBitBoard, GoBitBoard>&
 		int pos = 0;
 		while ((pos = bmNbrOwnBlocks.bitScanForward()) != -1) {
 			const GoGrid& grid = m_vGrids[pos];
-			const GoBlock* ownBlock = grid.getBlock();
+			const GoBlock* ownBlock = _getBlock(grid);
 			bmNbrOwnBlocks -= ownBlock->getGrids();
 			bmAllInfluence |= ownBlock->getGrids();
 			bmOwnBlock |= ownBlock->getGrids();
@@ -679,7 +636,7 @@ bool GoGame::isEatKoMove(const GoMove &move) const
 	//if (!grid.getPattern().getFalseEye(oppColor)) { return false; }
 	const vector<int> &vNbr = grid.getNeighbors();
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
-		const GoBlock* nbrBlock = m_vGrids[vNbr[i]].getBlock();
+		const GoBlock* nbrBlock = _getBlock(m_vGrids[vNbr[i]]);
 		if (!nbrBlock) { return false; }
 		if (nbrBlock->getColor() != oppColor) { return false; }
 	}
@@ -687,7 +644,7 @@ bool GoGame::isEatKoMove(const GoMove &move) const
 
 	bool bIsKoPlay = false;
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
-		const GoBlock* nbrBlock = m_vGrids[vNbr[i]].getBlock();
+		const GoBlock* nbrBlock = _getBlock(m_vGrids[vNbr[i]]);
 
 		assert(nbrBlock->getColor() == oppColor);
 
@@ -713,7 +670,7 @@ bool GoGame::isCaptureMove(const GoMove &move) const
 	const GoGrid& grid = m_vGrids[move.getPosition()];
 	const vector<int> &vNbr = m_vGrids[move.getPosition()].getNeighbors();
 	for (int i = 0; i < static_cast<int>(vNbr.size()); ++i) {
-		const GoBlock* nbrBlock = m_vGrids[vNbr[i]].getBlock();
+		const GoBlock* nbrBlock = _getBlock(m_vGrids[vNbr[i]]);
 		if (nbrBlock == NULL) continue;
 		if (nbrBlock->getColor() == ownColor) continue;
 		if (nbrBlock->getNumLiberty() == 1) { return true; }
@@ -722,178 +679,110 @@ bool GoGame::isCaptureMove(const GoMove &move) const
 	return false;
 }
 
-void GoGame::setFullBoardClosedArea(Color findColor) {
-	uint pos, numStone;
-	GoBitBoard bmFindCAStone = (findColor == COLOR_BLACK) ? ~m_stoneBitBoard.first - GoBitBoard::getPassBitBoard()
-														  : ~m_stoneBitBoard.second - GoBitBoard::getPassBitBoard();
+void GoGame::updateBensonLife() {
+	for (int c = 0; c < COLOR_SIZE - 1; ++c) {
+		if (!m_benson.m_bDirty[c]) { continue; }
+
+		GoBitBoard bmLife = findBensonLife(static_cast<Color>(c + 1));
+#ifdef GO
+		// legality depends on Benson region
+		if (GameConfigure::GO_FORBIDDEN_BENSON_REGION && bmLife != m_benson.m_bmLife[c]) { _clearLegalMoveCache(); }
+#endif
+		m_benson.m_bmLife[c] = bmLife;
+		m_benson.m_bDirty[c] = false;
+	}
+}
+
+GoBitBoard GoGame::findBensonLife(Color c) const {
+	// closed areas are regions of non-c points with at most MAX_UCT_CLOSEDAREA_SIZE points
+	// only healthy closed areas are kept, blocks and closed areas are linked by index bitboards
+	int numClosedArea = 0;
+	GoBitBoard vClosedArea[MAX_NUM_CLOSEDAREA];
+	GoBitBoard vBlockClosedAreaIDs[MAX_NUM_MOVES];
 
-	//find full board CA
+	int pos;
+	GoBitBoard bmFindCAStone = ~getStoneBitBoard(c) - GoBitBoard::getPassBitBoard();
 	while ((pos = bmFindCAStone.bitScanForward()) != -1) {
 		bmFindCAStone.setBitOn(pos);
 		GoBitBoard bmStone = bmFindCAStone.floodfill(pos);
 		bmFindCAStone -= bmStone;
-		numStone = bmStone.bitCount();
-
-		assert(("stone num == 0", numStone != 0));
+		if (bmStone.bitCount() > MAX_UCT_CLOSEDAREA_SIZE) { continue; }
 
-		if (numStone > MAX_UCT_CLOSEDAREA_SIZE) {
-			continue;
-		}
+		GoBitBoard bmBlockIDs = getClosedAreaBlockIDs(bmStone);
+		if (!isClosedAreaHealthy(bmStone, bmBlockIDs)) { continue; }
 
-		GoClosedArea *closedArea = m_closedAreas.NewOne();
-		setClosedAreaAttribute(closedArea, findColor, bmStone, numStone);
+		int id;
+		while ((id = bmBlockIDs.bitScanForward()) != -1) { vBlockClosedAreaIDs[id].setBitOn(numClosedArea); }
+		vClosedArea[numClosedArea++] = bmStone;
 	}
-}
 
-void GoGame::setClosedAreaAttribute(GoClosedArea *closedArea, Color caColor, GoBitBoard &bmStone, uint numStone) {
-	// set a new closed area attribute
-	//	1. set closed area type
-	//	2. link all grid to closed area
-	//	3. link neighbor block to closed area & add block to closed area
-	closedArea->init();
-	closedArea->setColor(caColor);
-	closedArea->setStoneMap(bmStone);
-	closedArea->setNumStone(numStone);
-
-	// set closed area type
-	closedArea->calculateCAType();
-
-	// link all grid to closed area
-	uint pos;
+	// do benson algorithm: remove blocks with less than 2 healthy closed areas and the closed areas next to them
+	int id;
+	GoBitBoard bmBlockIDs;
+	GoBitBoard bmStone = getStoneBitBoard(c);
 	while ((pos = bmStone.bitScanForward()) != -1) {
-		GoGrid &grid = m_vGrids[pos];
-
-		assert(("", grid.getColor() != caColor));
-		assert(("grid have been assigned", grid.getClosedArea(caColor) == NULL));
-
-		grid.setClosedArea(closedArea, caColor);
+		const GoBlock *b = _getBlock(m_vGrids[pos]);
+		bmBlockIDs.setBitOn(b->getIndex());
+		bmStone -= b->getGrids();
 	}
+	GoBitBoard bmClosedAreaIDs;
+	for (id = 0; id < numClosedArea; ++id) { bmClosedAreaIDs.setBitOn(id); }
 
-	// link neighbor block to closed area
-	GoBitBoard bmSurroundStone = closedArea->getSurroundBitBoard();
-	while ((pos = bmSurroundStone.bitScanForward()) != -1) {
-		GoBlock *nbrBlock = m_vGrids[pos].getBlock();
-
-		assert(("", nbrBlock));
-		assert(("", nbrBlock->getColor() == caColor));
-		assert(("", !nbrBlock->hasClosedArea(closedArea)));
-
-		nbrBlock->addClosedArea(closedArea);
-		closedArea->addBlockID(nbrBlock->getIndex());
-		bmSurroundStone -= nbrBlock->getGrids();
-	}
-}
-
-void GoGame::setFullBoardBensonLife() {
-	Benson benson;
-	findBensonSet(benson);
-	findBensonLife(benson);
-	setBensonLife(benson);
-}
-
-bool GoGame::isCAHealthy(const GoClosedArea *closedArea) const {
-	if (closedArea->getNumStone() == 1) {
-		return true;
-	}
-	if (closedArea->getNumBlock() == 1 && closedArea->getNumStone() < 3) {
-		return true;
-	}
+	bool bIsOver = false;
+	while (!bIsOver) {
+		bIsOver = true;
+		GoBitBoard bmCheckBlockIDs = bmBlockIDs;
+		while ((id = bmCheckBlockIDs.bitScanForward()) != -1) {
+			if ((vBlockClosedAreaIDs[id] & bmClosedAreaIDs).bitCount() >= 2) { continue; }
 
-	for (uint iNum = 0; iNum < closedArea->getNumBlock(); iNum++) {
-		GoBitBoard bmCaNbrBlock = m_vBlocks[closedArea->getBlockID(iNum)].getStonenNbrMap();
-		GoBitBoard bmBoard = m_stoneBitBoard.first | m_stoneBitBoard.second;
-		if (!(closedArea->getStoneMap() & ~bmCaNbrBlock & ~bmBoard).empty()) {
-			return false;
+			bIsOver = false;
+			bmBlockIDs.setBitOff(id);
+			bmClosedAreaIDs -= vBlockClosedAreaIDs[id];
 		}
 	}
 
-	return true;
+	GoBitBoard bmLife;
+	while ((id = bmBlockIDs.bitScanForward()) != -1) { bmLife |= m_vBlocks[id].getGrids(); }
+	while ((id = bmClosedAreaIDs.bitScanForward()) != -1) { bmLife |= vClosedArea[id]; }
+	return bmLife;
 }
 
-void GoGame::findBensonSet(Benson &benson) const {
-	// find closed area
-	for (uint iIndex = 0; iIndex < m_closedAreas.getCapacity(); ++iIndex) {
-		if (!m_closedAreas.isValidIdx(iIndex)) {
-			continue;
-		}
-		const GoClosedArea *closedArea = m_closedAreas.getAt(iIndex);
-		if (!isCAHealthy(closedArea)) {
-			continue;
-		}
-		benson.m_closedAreaIDs.addFeature(closedArea->GetID());
-	}
-
-	// find block
-	GoBitBoard bmBlocks = ~m_bmBlockUsage;
-	int id;
-	while ((id = bmBlocks.bitScanForward()) != -1) {
-		const GoBlock block = m_vBlocks[id];
-		uint numHealthyCA = block.getNumClosedArea();
-		for (uint iNum = 0; iNum < block.getNumClosedArea(); ++iNum) {
-			uint closedAreaID = block.getClosedAreaID(iNum);
-			if (benson.m_closedAreaIDs.contains(closedAreaID)) {
-				continue;
-			}
-			--numHealthyCA;
-		}
-		benson.m_blockIDs.addFeature(block.getIndex());
-		benson.m_blockNumHealthyCA[block.getIndex()] = numHealthyCA;
+GoBitBoard GoGame::getClosedAreaBlockIDs(const GoBitBoard &bmClosedArea) const {
+	GoBitBoard bmBlockIDs;
+	GoBitBoard bmSurroundStone = bmClosedArea.dilation() - bmClosedArea;
+	int pos;
+	while ((pos = bmSurroundStone.bitScanForward()) != -1) {
+		const GoBlock *nbrBlock = _getBlock(m_vGrids[pos]);
+		assert(("surrounding stone without block", nbrBlock));
+		bmBlockIDs.setBitOn(nbrBlock->getIndex());
+		bmSurroundStone -= nbrBlock->getGrids();
 	}
+	return bmBlockIDs;
 }
 
-void GoGame::findBensonLife(Benson &benson) const {
-	// do benson algorithm
-	bool bIsOver = false;
-
-	while (!bIsOver) {
-		bIsOver = true;
-
-		for (uint iIndex = 0; iIndex < benson.m_blockIDs.size(); ++iIndex) {
-			const GoBlock block = m_vBlocks[benson.m_blockIDs[iIndex]];
-
-			if (benson.m_blockNumHealthyCA[block.getIndex()] >= 2) {
-				continue;
-			}
+bool GoGame::isClosedAreaHealthy(const GoBitBoard &bmClosedArea, const GoBitBoard &bmBlockIDs) const {
+	int numStone = bmClosedArea.bitCount();
+	if (numStone == 1) { return true; }
+	if (bmBlockIDs.bitCount() == 1 && numStone < 3) { return true; }
 
-			bIsOver = false;
-			benson.m_blockIDs.removeFeature(block.getIndex());
-			for (uint iNumCA = 0; iNumCA < block.getNumClosedArea(); ++iNumCA) {
-				uint blockNbrCAID = block.getClosedAreaID(iNumCA);
-				const GoClosedArea *blockNbrCA = m_closedAreas.getAt(blockNbrCAID);
-				if (!benson.m_closedAreaIDs.contains(blockNbrCAID)) {
-					continue;
-				}
-				benson.m_closedAreaIDs.removeFeature(blockNbrCAID);
-				for (uint iNumBlock = 0; iNumBlock < blockNbrCA->getNumBlock(); iNumBlock++) {
-					--benson.m_blockNumHealthyCA[blockNbrCA->getBlockID(iNumBlock)];
-				}
-			}
-		}
+	// every empty point should be a liberty of all surrounding blocks
+	GoBitBoard bmEmpty = bmClosedArea - (m_stoneBitBoard.first | m_stoneBitBoard.second);
+	GoBitBoard bmCheckBlockIDs = bmBlockIDs;
+	int id;
+	while ((id = bmCheckBlockIDs.bitScanForward()) != -1) {
+		if (!(bmEmpty - m_vBlocks[id].getStonenNbrMap()).empty()) { return false; }
 	}
+	return true;
 }
 
-void GoGame::setBensonLife(Benson &benson) {
-	// set block life
-	for (uint iNum = 0; iNum < benson.m_blockIDs.size(); ++iNum) {
-		GoBlock &block = m_vBlocks[benson.m_blockIDs[iNum]];
-		if (block.getColor() == COLOR_BLACK) {
-			m_numLifeStone.first += block.getNumStone();
-			m_bmBenson.first |= block.getGrids();
-		} else if (block.getColor() == COLOR_WHITE) {
-			m_numLifeStone.second += block.getNumStone();
-			m_bmBenson.second |= block.getGrids();
-		}
-	}
+bool GoGame::isBensonAffectedByMove(const GoMove &move) const {
+	// called before the stone is placed: the opponent's closed areas keep their shape,
+	// and the one containing the move can only become healthier, so only an unhealthy one matters
+	Color oppColor = AgainstColor(move.getColor());
+	int pos = move.getPosition();
+	if (getBensonBitboard(oppColor).BitIsOn(pos)) { return false; }
 
-	// set closed area life
-	for (uint iNum = 0; iNum < benson.m_closedAreaIDs.size(); ++iNum) {
-		GoClosedArea *closedArea = m_closedAreas.getAt(benson.m_closedAreaIDs[iNum]);
-		if (closedArea->getColor() == COLOR_BLACK) {
-			m_numLifeStone.first += closedArea->getNumStone();
-			m_bmBenson.first |= closedArea->getStoneMap();
-		} else if (closedArea->getColor() == COLOR_WHITE) {
-			m_numLifeStone.second += closedArea->getNumStone();
-			m_bmBenson.second |= closedArea->getStoneMap();
-		}
-	}
+	GoBitBoard bmStone = (~getStoneBitBoard(oppColor) - GoBitBoard::getPassBitBoard()).floodfill(pos);
+	if (bmStone.bitCount() > MAX_UCT_CLOSEDAREA_SIZE) { return false; }
+	return !isClosedAreaHealthy(bmStone, getClosedAreaBlockIDs(bmStone));
 }
\ No newline at end of file
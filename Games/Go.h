@@ -1,7 +1,5 @@
 #pragma once
 #include "Bitboard.h"
-#include "FeatureIndexList.h"
-#include "FeatureList.h"
 #include "GameBase.h"
 #include "GameConfigure.h"
 #include "HashTable.h"
@@ -49,105 +47,6 @@ inline string getGoLifeAndDeathString(GoLifeAndDeathStatus status) {
 	}
 }
 
-class GoClosedArea {
-  public:
-	enum ClosedAreaType {
-		CA_UNKNOWN,
-		CA_CORNER,
-		CA_EDGE,
-		CA_CENTRAL
-	};
-
-  private:
-	// TODO m_id type
-	uint m_id;
-	Color m_color;
-	uint m_numStone;
-	GoBitBoard m_bmStone;
-	FeatureIndexList<int, MAX_GAME_LENGTH> m_blockIDs;
-	GoLifeAndDeathStatus m_status;
-	ClosedAreaType m_type;
-
-  public:
-	GoClosedArea() { Clear(); }
-
-	void Clear() {
-		m_id = static_cast<uint>(-1);
-	}
-	void init() {
-		m_color = COLOR_NONE;
-		m_numStone = 0;
-		m_bmStone.reset();
-		m_blockIDs.clear();
-		m_status = LAD_NOT_EYE;
-		m_type = CA_UNKNOWN;
-	}
-	inline uint GetID() const { return m_id; }
-	inline void SetID(uint id) { m_id = id; }
-
-	inline Color getColor() const { return m_color; }
-	inline void setColor(Color c) { m_color = c; }
-
-	inline uint getNumStone() const { return m_numStone; }
-	inline void setNumStone(uint numStone) { m_numStone = numStone; }
-	inline void decNumStone() { --m_numStone; }
-	inline void incNumStone() { ++m_numStone; }
-
-	inline void addBlockID(uint blockID) { m_blockIDs.addFeature(blockID); }
-	inline void deleteBlockID(uint blockID) { m_blockIDs.removeFeature(blockID); }
-	inline bool hasBlockID(uint blockID) const { return m_blockIDs.contains(blockID); }
-	inline uint getNumBlock() const { return m_blockIDs.getNumFeature(); }
-	inline uint getBlockID(uint idx) const { return m_blockIDs[idx]; }
-
-	inline GoBitBoard &getStoneMap() { return m_bmStone; }
-	inline const GoBitBoard &getStoneMap() const { return m_bmStone; }
-	inline void setStoneMap(const GoBitBoard &bmStone) { m_bmStone = bmStone; }
-	inline void setStoneMapOff(uint pos) { m_bmStone.setBitOff(pos); }
-	inline GoBitBoard getSurroundBitBoard() const { return m_bmStone.dilation() & ~m_bmStone; }
-
-	inline void setStatus(GoLifeAndDeathStatus status) { m_status = status; }
-	inline GoLifeAndDeathStatus getStatus() const { return m_status; }
-
-	inline void calculateCAType() {
-		if (!(GoBitBoard::getCornerBitBoard()).empty()) {
-			m_type = CA_CORNER;
-		} else if (!(GoBitBoard::getEdgeBitBoard()).empty()) {
-			m_type = CA_EDGE;
-		} else {
-			m_type = CA_CENTRAL;
-		}
-	}
-	inline ClosedAreaType getType() const { return m_type; }
-
-	inline void merge(const GoClosedArea *mergeCA) {
-		assert(mergeCA->getColor() == m_color);
-
-		m_numStone += mergeCA->getNumStone();
-		m_bmStone |= mergeCA->getStoneMap();
-		for (uint iNum = 0; iNum < mergeCA->getNumBlock(); iNum++) {
-			const uint iID = mergeCA->getBlockID(iNum);
-			if (!hasBlockID(iID)) {
-				addBlockID(iID);
-			}
-		}
-	}
-
-	inline void removePoint(uint pos) {
-		assert(m_bmStone.BitIsOn(pos));
-
-		m_bmStone.setBitOff(pos);
-		--m_numStone;
-		calculateCAType();
-	}
-	inline void addPoint(uint pos) {
-		assert(!m_bmStone.BitIsOn(pos));
-
-		m_bmStone.setBitOn(pos);
-		++m_numStone;
-		calculateCAType();
-	}
-};
-
 class GoBlock {
   public:
 	enum BlockStatus {
@@ -164,8 +63,6 @@ class GoBlock {
 	GoBitBoard m_grids;
 	GoBitBoard m_liberties;
 
-	//closed area
-	FeatureIndexList<int, MAX_NUM_MOVES> m_closedAreas;
 	GoLifeAndDeathStatus m_LADStatus;
 
   public:
@@ -179,7 +76,6 @@ class GoBlock {
 		m_hashKey = 0;
 		m_grids.reset();
 		m_liberties.reset();
-		m_closedAreas.clear();
 
 		// TODO Benson, now assume all block life
 		m_LADStatus = LAD_LIFE;
@@ -229,28 +125,17 @@ class GoBlock {
 	inline GoBitBoard getStonenNbrMap() const { return m_grids.dilation(); }
 	inline int getNumStone() const { return m_grids.bitCount(); }
 
-	// closed area
-	inline void addClosedArea(GoClosedArea *ca) { m_closedAreas.addFeature(ca->GetID()); }
-	inline void deleteClosedArea(GoClosedArea *ca) { m_closedAreas.removeFeature(ca->GetID()); }
-	inline void deleteClosedArea(int idx) { m_closedAreas.removeFeature(idx); }
-	inline void deleteClosedArea() { m_closedAreas.clear(); }
-	inline bool hasClosedArea(const GoClosedArea *ca) const { return m_closedAreas.contains(ca->GetID()); }
 	inline void setStatus(GoLifeAndDeathStatus status) { m_LADStatus = status; }
 	inline GoLifeAndDeathStatus getStatus() const { return m_LADStatus; }
-	inline uint getNumClosedArea() const { return m_closedAreas.size(); }
-	inline uint getClosedAreaID(uint idx) const { return m_closedAreas[idx]; }
 };
 
 class GoGrid {
   private:
 	Color m_color;
 	int m_position;
-	GoBlock *m_block;
-	string ss;
+	int m_blockIndex; // index in GoGame::m_vBlocks (-1 if empty), so copied games do not share blocks
 	vector<int> m_vNeighbors;
 	GoBitBoard m_bmEyeCorners;
-	// closed area
-	pair<GoClosedArea *, GoClosedArea *> m_closedArea;
 
   public:
 	GoGrid(int position, int boardSize) {
@@ -258,41 +143,21 @@ class GoGrid {
 		clear();
 		m_position = position;
 		_initializeNeighbors(boardSize);
-		ss.resize(10000);
 	}
 
 	void clear() {
-		m_block = nullptr;
+		m_blockIndex = -1;
 		m_color = COLOR_NONE;
-		m_closedArea.first = nullptr;
-		m_closedArea.second = nullptr;
 	}
 
 	inline void setColor(Color c) { m_color = c; }
-	inline void setBlock(GoBlock *b) { m_block = b; }
+	inline void setBlockIndex(int index) { m_blockIndex = index; }
 	inline Color getColor() const { return m_color; }
 	inline int getPosition() const { return m_position; }
-	inline GoBlock *getBlock() { return m_block; }
-	inline const GoBlock *getBlock() const { return m_block; }
+	inline int getBlockIndex() const { return m_blockIndex; }
 	inline const vector<int> &getNeighbors() const { return m_vNeighbors; }
 	inline const GoBitBoard &getEyeCorners() const { return m_bmEyeCorners; }
 
-	// closed area
-	inline pair<GoClosedArea *, GoClosedArea *> &getClosedArea() { return m_closedArea; }
-	inline const pair<GoClosedArea *, GoClosedArea *> &getClosedArea() const { return m_closedArea; }
-	inline GoClosedArea *getClosedAreaP(Color c) { return (c == COLOR_BLACK) ? m_closedArea.first : m_closedArea.second; }
-	inline const GoClosedArea *getClosedArea(Color c) const { return (c == COLOR_BLACK) ? m_closedArea.first : m_closedArea.second; }
-	inline void setClosedArea(GoClosedArea *closedArea, Color c) {
-		if (c == COLOR_BLACK)
-			m_closedArea.first = closedArea;
-		else
-			m_closedArea.second = closedArea;
-	}
-	inline void deleteClosedArea() {
-		m_closedArea.first = nullptr;
-		m_closedArea.second = nullptr;
-	}
-
   private:
 	void _initializeNeighbors(int boardSize) {
 		int x = m_position % boardSize;
@@ -342,23 +207,36 @@ class GoGame : public _Game<GoMove> {
 	static HashKey m_turnHashkey;
 	static bool initialized;
 	vector<HashKey> m_vHash;
+	HashKey m_occupiedKoHashKey; // xor of m_vKoHash over occupied points
+
+	// legal moves of each color, computed on demand and kept for the positions in history
+	struct LegalMoveCache {
+		GoBitBoard m_bmLegal[COLOR_SIZE - 1];
+		bool m_bComputed[COLOR_SIZE - 1];
+	};
+	mutable LegalMoveCache m_legalMoveCache;
+	vector<LegalMoveCache> m_vLegalMoveCache;
 
 	// force move
 	map<int, string> m_mForceMoves;
 
-	// closed area
-	vector<GoBlock> m_vclosedAreas;
-	GoBitBoard m_bmclosedAreaUsage;
-	FeatureList<GoClosedArea, MAX_NUM_MOVES> m_closedAreas;
-
-	// Benson
-	struct Benson {
-		short m_blockNumHealthyCA[MAX_GAME_LENGTH];
-		FeatureIndexList<uint, MAX_GAME_LENGTH> m_blockIDs;
-		FeatureIndexList<uint, MAX_NUM_CLOSEDAREA> m_closedAreaIDs;
+	// undo: blocks before each move are saved, undo writes them back instead of rebuilding blocks
+	struct UndoRecord {
+		HashKey m_occupiedKoHashKey;
+		GoBitBoard m_bmBlockUsage;
+		int m_blockStart; // start index in m_vUndoBlocks
+	};
+	vector<UndoRecord> m_vUndoRecords;
+	vector<GoBlock> m_vUndoBlocks;
+	GoBitBoard m_bmSavedBlock;
+
+	// Benson life of each color, only the colors affected by a move are recomputed and undo restores the previous one
+	struct BensonLife {
+		GoBitBoard m_bmLife[COLOR_SIZE - 1];
+		bool m_bDirty[COLOR_SIZE - 1];
 	};
-	pair<GoBitBoard, GoBitBoard> m_bmBenson;
-	pair<int, int> m_numLifeStone;
+	BensonLife m_benson;
+	vector<BensonLife> m_vBenson;
 
   public:
 	GoGame() : _Game() {
@@ -391,7 +269,6 @@ class GoGame : public _Game<GoMove> {
 		initialized = true;
 	}
 
-	void resetCA();
 	void reset();
 	void play(const GoMove &move);
 	// Fast undo
@@ -399,7 +276,11 @@ class GoGame : public _Game<GoMove> {
 	// Trivial undo
 	void deepCheck();
 	void trivialUndo();
-	bool isLegalMove(const GoMove &move) const;
+	inline bool isLegalMove(const GoMove &move) const {
+		assert(("Invalid move position", move.getPosition() >= 0 && move.getPosition() < getMaxNumLegalAction()));
+		return getLegalBitBoard(move.getColor()).BitIsOn(move.getPosition());
+	}
+	const GoBitBoard& getLegalBitBoard(Color c) const;
 	bool isBadMove(const GoMove &move) const;
 	bool isOwnTrueEye(const GoMove &move) const;
 	bool isLastMoveCaptureBlock() const;
@@ -409,14 +290,12 @@ class GoGame : public _Game<GoMove> {
 	string getFinalScore() const;
 	Color getColor(int position) const;
 	vector<float> getFeatures(SymmetryType type = SYM_NORMAL) const;
+	void getFeatures(float* pFeatures, SymmetryType type = SYM_NORMAL) const;
+	void getLegalMoveMask(int* pLegalMove, int* pBadMove) const;
 	HashKey getTTHashKey() const;
 
-	// closed area
-	inline void findFullBoardUCTClosedArea() {
-		setFullBoardClosedArea(COLOR_BLACK);
-		setFullBoardClosedArea(COLOR_WHITE);
-		setFullBoardBensonLife();
-	}
+	// Benson
+	void updateBensonLife();
 
 	// overwrite static function
 	static int getBoardSize() { return BOARD_SIZE; }
@@ -426,12 +305,20 @@ class GoGame : public _Game<GoMove> {
   private:
 	void _initialize();
 	void _setColor(const GoMove &move);
+	bool _isLegalMove(const GoMove &move) const;
+	inline void _clearLegalMoveCache() { m_legalMoveCache.m_bComputed[0] = m_legalMoveCache.m_bComputed[1] = false; }
+	inline GoBlock *_getBlock(const GoGrid &g) { return (g.getBlockIndex() == -1) ? nullptr : &m_vBlocks[g.getBlockIndex()]; }
+	inline const GoBlock *_getBlock(const GoGrid &g) const { return (g.getBlockIndex() == -1) ? nullptr : &m_vBlocks[g.getBlockIndex()]; }
 	GoBlock *_newBlock(Color c);
 	void _removeBlock(GoBlock *b);
 	void _removeBlockAndGrids(GoBlock *b);
 	void _addGridAndLibertiesToBlock(GoMove m, GoBlock *b, const GoBitBoard &bmNbrLiberties);
-	void _addGridsAndLibertiesToBlock(GoBitBoard &bmGrids, GoBlock *b, const GoBitBoard &bmNbrLiberties);
 	GoBlock *_combineBlocks(GoBlock *b1, GoBlock *b2);
+	inline void _saveBlock(const GoBlock *b) {
+		if (m_bmSavedBlock.BitIsOn(b->getIndex())) { return; }
+		m_bmSavedBlock.setBitOn(b->getIndex());
+		m_vUndoBlocks.push_back(*b);
+	}
 
 	// Board information
 	inline GoBitBoard getStoneBitBoard(Color c) const {	return (c == COLOR_BLACK ? m_stoneBitBoard.first : m_stoneBitBoard.second); }
@@ -442,18 +329,13 @@ class GoGame : public _Game<GoMove> {
 	bool isEatKoMove(const GoMove &move) const;
 	bool isCaptureMove(const GoMove &move) const;
 
-	// closed area
-	bool isCAHealthy(const GoClosedArea *closedArea) const;
-	void setFullBoardClosedArea(Color findColor);
-	void setClosedAreaAttribute(GoClosedArea *closedArea, Color caColor, GoBitBoard &bmStone, uint numStone);
-	void setFullBoardBensonLife();
-
 	// Benson
-	void findBensonSet(Benson &benson) const;
-	void findBensonLife(Benson &benson) const;
-	void setBensonLife(Benson &benson);
+	GoBitBoard findBensonLife(Color c) const;
+	GoBitBoard getClosedAreaBlockIDs(const GoBitBoard &bmClosedArea) const;
+	bool isClosedAreaHealthy(const GoBitBoard &bmClosedArea, const GoBitBoard &bmBlockIDs) const;
+	bool isBensonAffectedByMove(const GoMove &move) const;
 	GoBitBoard getBensonBitboard(Color c) const {
 		assert(c == COLOR_BLACK || c == COLOR_WHITE);
-		return (c == COLOR_BLACK) ? m_bmBenson.first : m_bmBenson.second;
+		return m_benson.m_bmLife[c - 1];
 	}
 };
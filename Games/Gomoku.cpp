@@ -1,4 +1,8 @@
-#include "Gomoku.h"
-
+#include "Gomoku.h"
+
 vector<vector<HashKey>> GomokuGame::m_vGridHash;
+vector<vector<int>> GomokuGame::m_vFeaturePosition;
+int GomokuGame::m_lineIndex[GomokuGame::NUM_LINE_DIRECTION][225];
+int GomokuGame::m_lineBit[GomokuGame::NUM_LINE_DIRECTION][225];
+unsigned int GomokuGame::m_invalidLineMask[GomokuGame::NUM_LINE_DIRECTION][GomokuGame::MAX_NUM_LINE];
 bool GomokuGame::initialized;
@@ -2,6 +2,7 @@
 #include "GameConfigure.h"
 #include "GameBase.h"
 #include "Rand64.h"
+#include "Bitboard.h"
 
 class GomokuMove : public _Move {
 public:
@@ -13,14 +14,27 @@ public:
 	~GomokuMove() {}
 };
 
+typedef Bitboard<225, 15> GomokuBitBoard;
+
 class GomokuGame : public _Game<GomokuMove> {
+	static const int NUM_LINE_DIRECTION = 4;
+	static const int MAX_NUM_LINE = 29;
+
 private:
 	vector<Color> m_vBoard;
+	int m_nEmpty;
+	GomokuBitBoard m_bmEmpty;
+	GomokuBitBoard m_bmStone[COLOR_SIZE - 1];
+	unsigned int m_lineMask[COLOR_SIZE - 1][NUM_LINE_DIRECTION][MAX_NUM_LINE]; // stones of each line, indexed by m_lineBit
 	vector<int> m_threatRecord;
 	int m_currentThreat;
 	Color m_winner;
 
 	static vector<vector<HashKey>> m_vGridHash;
+	static vector<vector<int>> m_vFeaturePosition;
+	static int m_lineIndex[NUM_LINE_DIRECTION][225];
+	static int m_lineBit[NUM_LINE_DIRECTION][225];
+	static unsigned int m_invalidLineMask[NUM_LINE_DIRECTION][MAX_NUM_LINE];
 	static bool initialized;
 
 public:
@@ -40,6 +54,31 @@ public:
 				m_vGridHash[pos][c] = rand64();
 			}
 		}
+
+		// position of each point in feature planes for each symmetry
+		m_vFeaturePosition.resize(SYMMETRY_SIZE, vector<int>(getMaxNumLegalAction()));
+		for (int type = 0; type < SYMMETRY_SIZE; ++type) {
+			for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
+				m_vFeaturePosition[type][pos] = getRotatePosition(pos, getBoardSize(), static_cast<SymmetryType>(type));
+			}
+		}
+
+		// line index and bit of each point for each direction, bits out of board are invalid
+		for (int dir = 0; dir < NUM_LINE_DIRECTION; ++dir) {
+			for (int line = 0; line < MAX_NUM_LINE; ++line) { m_invalidLineMask[dir][line] = ~0u; }
+		}
+		for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
+			const int i = pos / getBoardSize();
+			const int j = pos % getBoardSize();
+			const int vLine[NUM_LINE_DIRECTION] = { i, j, i - j + getBoardSize() - 1, i + j };
+			const int vBit[NUM_LINE_DIRECTION] = { j, i, j, j };
+			for (int dir = 0; dir < NUM_LINE_DIRECTION; ++dir) {
+				m_lineIndex[dir][pos] = vLine[dir];
+				m_lineBit[dir][pos] = vBit[dir];
+				m_invalidLineMask[dir][vLine[dir]] &= ~(1u << vBit[dir]);
+				assert(("Inconsistent line position", getLinePosition(dir, vLine[dir], vBit[dir]) == pos));
+			}
+		}
 		initialized = true;
 	}
 
@@ -49,6 +88,12 @@ public:
 		m_hashKey = 0;
 		m_vBoard.resize(getBoardSize() * getBoardSize());
 		fill(m_vBoard.begin(), m_vBoard.end(), COLOR_NONE);
+		m_nEmpty = getMaxNumLegalAction();
+		m_bmEmpty.reset();
+		for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) { m_bmEmpty.setBitOn(pos); }
+		m_bmStone[COLOR_BLACK - 1].reset();
+		m_bmStone[COLOR_WHITE - 1].reset();
+		memset(m_lineMask, 0, sizeof(m_lineMask));
 		m_threatRecord.clear();
 		m_currentThreat = -1;
 		m_winner = COLOR_NONE;
@@ -62,6 +107,10 @@ public:
 
 		_Game::play(move);
 		m_vBoard[move.getPosition()] = move.getColor();
+		m_bmEmpty.setBitOff(move.getPosition());
+		m_bmStone[move.getColor() - 1].setBitOn(move.getPosition());
+		toggleLineBit(move.getPosition(), move.getColor());
+		--m_nEmpty;
 		m_turnColor = AgainstColor(move.getColor());
 		m_hashKey ^= m_vGridHash[move.getPosition()][move.getColor() - 1];
 
@@ -82,9 +131,23 @@ public:
 		return false;
 	}
 
+	// the threat point if the opponent has a threat, otherwise all empty points
+	inline GomokuBitBoard getLegalBitBoard() const {
+		return hasCurrentThreat() ? GomokuBitBoard(m_currentThreat) : m_bmEmpty;
+	}
+
+	void getLegalMoveMask(int* pLegalMove, int* pBadMove) const {
+		fill(pLegalMove, pLegalMove + getMaxNumLegalAction(), 0);
+		fill(pBadMove, pBadMove + getMaxNumLegalAction(), 0);
+
+		int pos;
+		GomokuBitBoard bmLegal = getLegalBitBoard();
+		while ((pos = bmLegal.bitScanForward()) != -1) { pLegalMove[pos] = 1; }
+	}
+
 	inline bool isTerminal() {
 		// terminal: all points are played by "O" or "X" || any player wins
-		return (eval() != COLOR_NONE || find(m_vBoard.begin(), m_vBoard.end(), COLOR_NONE) == m_vBoard.end());
+		return (eval() != COLOR_NONE || m_nEmpty == 0);
 	}
 
 	inline bool hasCurrentThreat() const { return m_currentThreat != -1; }
@@ -96,93 +159,6 @@ public:
 	inline Color eval() const {
 		return m_winner;
 	}
-  /*
-	inline Color eval() const {
-		if (m_vMoves.empty()) {
-			return COLOR_NONE;
-		}
-
-		const int lastMoveIndex = m_vMoves.back().getPosition();
-		const Color c = m_vBoard[lastMoveIndex];
-		const int i = lastMoveIndex / getBoardSize();
-		const int j = lastMoveIndex % getBoardSize();
-		int chessCount;
-
-		// rows
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (j + k >= getBoardSize() || m_vBoard[to1DIndex(i, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (j - k < 0 || m_vBoard[to1DIndex(i, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { return c; }
-
-		// columns
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i + k >= getBoardSize() || m_vBoard[to1DIndex(i + k, j)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (i - k < 0 || m_vBoard[to1DIndex(i - k, j)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { return c; }
-
-		// diagonal (left-up to right-down)
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i + k >= getBoardSize() || j + k >= getBoardSize() || m_vBoard[to1DIndex(i + k, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (i - k < 0 || j - k < 0 || m_vBoard[to1DIndex(i - k, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { return c; }
-
-		// diagonal (left-down to right-up)
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i - k < 0 || j + k >= getBoardSize() || m_vBoard[to1DIndex(i - k, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (i + k >= getBoardSize() || j - k < 0 || m_vBoard[to1DIndex(i + k, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { return c; }
-
-		return COLOR_NONE;
-	}
-  */
 
 	string getFinalScore() const {
 		Color winner = eval();
@@ -196,6 +172,10 @@ public:
 
 		GomokuMove& preMove = m_vMoves.back();
 		m_vBoard[preMove.getPosition()] = COLOR_NONE;
+		m_bmEmpty.setBitOn(preMove.getPosition());
+		m_bmStone[preMove.getColor() - 1].setBitOff(preMove.getPosition());
+		toggleLineBit(preMove.getPosition(), preMove.getColor());
+		++m_nEmpty;
 		m_turnColor = preMove.getColor();
 		m_hashKey ^= m_vGridHash[preMove.getPosition()][preMove.getColor() - 1];
 		m_vMoves.pop_back();
@@ -211,20 +191,27 @@ public:
 	}
 
 	vector<float> getFeatures(SymmetryType type = SYM_NORMAL) const {
-		vector<float> vFeatures;
-		// 4 feature planes (Black Board/White Board/Turn Color)
-		for (int channel = 0; channel < getNumChannels(); ++channel) {
-			for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
-				int rotatePos = getRotatePosition(pos, getBoardSize(), ReverseSymmetricType[type]);
-				if (channel == 0) { vFeatures.push_back((m_vBoard[rotatePos] == m_turnColor ? 1.0f : 0.0f)); }
-				else if (channel == 1) { vFeatures.push_back((m_vBoard[rotatePos] == AgainstColor(m_turnColor) ? 1.0f : 0.0f)); }
-				else if (channel == 2) { vFeatures.push_back((m_turnColor == COLOR_BLACK ? 1.0f : 0.0f)); }
-				else if (channel == 3) { vFeatures.push_back((m_turnColor == COLOR_WHITE ? 1.0f : 0.0f)); }
-			}
-		}
+		vector<float> vFeatures(getNumChannels() * getMaxNumLegalAction());
+		getFeatures(vFeatures.data(), type);
 		return vFeatures;
 	}
 
+	void getFeatures(float* pFeatures, SymmetryType type = SYM_NORMAL) const {
+		// 4 feature planes (Black Board/White Board/Turn Color), stones are placed by the symmetry table
+		assert(("Invalid turn color", m_turnColor == COLOR_BLACK || m_turnColor == COLOR_WHITE));
+		const int size = getMaxNumLegalAction();
+		fill(pFeatures, pFeatures + 2 * size, 0.0f);
+		fill(pFeatures + 2 * size, pFeatures + 3 * size, (m_turnColor == COLOR_BLACK ? 1.0f : 0.0f));
+		fill(pFeatures + 3 * size, pFeatures + 4 * size, (m_turnColor == COLOR_WHITE ? 1.0f : 0.0f));
+
+		int pos;
+		const vector<int>& vFeaturePosition = m_vFeaturePosition[type];
+		GomokuBitBoard bmOwn = m_bmStone[m_turnColor - 1];
+		GomokuBitBoard bmOpponent = m_bmStone[AgainstColor(m_turnColor) - 1];
+		while ((pos = bmOwn.bitScanForward()) != -1) { pFeatures[vFeaturePosition[pos]] = 1.0f; }
+		while ((pos = bmOpponent.bitScanForward()) != -1) { pFeatures[size + vFeaturePosition[pos]] = 1.0f; }
+	}
+
 	// overwrite static function
 	static int getBoardSize() { return 15; }
 	static int getMaxNumLegalAction() { return 225; }
@@ -232,184 +219,77 @@ public:
 
 private:
 
-  inline void updateConnection() {
-		if (m_vMoves.empty()) {
-			return;
-		}
-
-		const int lastMoveIndex = m_vMoves.back().getPosition();
-		const Color c = m_vBoard[lastMoveIndex];
-		const int i = lastMoveIndex / getBoardSize();
-		const int j = lastMoveIndex % getBoardSize();
-		int chessCount;
-
-		// rows
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (j + k >= getBoardSize() || m_vBoard[to1DIndex(i, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (j - k < 0 || m_vBoard[to1DIndex(i, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { 
-      m_winner = c;
-      return;
-    }
-
-		// columns
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i + k >= getBoardSize() || m_vBoard[to1DIndex(i + k, j)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (i - k < 0 || m_vBoard[to1DIndex(i - k, j)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { 
-      m_winner = c;
-      return;
-    }
-
-		// diagonal (left-up to right-down)
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i + k >= getBoardSize() || j + k >= getBoardSize() || m_vBoard[to1DIndex(i + k, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		for (int k = 1; k < 5; k++) {
-			if (i - k < 0 || j - k < 0 || m_vBoard[to1DIndex(i - k, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
-			}
-		}
-		if (chessCount >= 5) { 
-      m_winner = c;
-      return;
-    }
-
-		// diagonal (left-down to right-up)
-		chessCount = 0;
-		for (int k = 0; k < 5; k++) {
-			if (i - k < 0 || j + k >= getBoardSize() || m_vBoard[to1DIndex(i - k, j + k)] != c) {
-				break;
-			} else {
-				chessCount++;
+	// five in a row through the last move
+	inline void updateConnection() {
+		if (m_vMoves.empty()) { return; }
+
+		const int position = m_vMoves.back().getPosition();
+		const Color c = m_vBoard[position];
+		for (int dir = 0; dir < NUM_LINE_DIRECTION; ++dir) {
+			// bit b of five is on if b ~ b+4 are all own stones, check the segments which start at (bit-4) ~ bit
+			const unsigned int own = m_lineMask[c - 1][dir][m_lineIndex[dir][position]];
+			const unsigned int five = own & (own >> 1) & (own >> 2) & (own >> 3) & (own >> 4);
+			if (five & ((0x1Fu << m_lineBit[dir][position]) >> 4)) {
+				m_winner = c;
+				return;
 			}
 		}
-		for (int k = 1; k < 5; k++) {
-			if (i + k >= getBoardSize() || j - k < 0 || m_vBoard[to1DIndex(i + k, j - k)] != c) {
-				break;
-			} else {
-				chessCount++;
+	}
+
+	inline void updateThreat() {
+		m_threatRecord.push_back(m_currentThreat);
+		m_currentThreat = -1;
+		for (int dir = 0; dir < NUM_LINE_DIRECTION; ++dir) { updateLineThreat(dir); }
+	}
+
+	inline void updateLineThreat(int dir) {
+		if (m_winner != COLOR_NONE) { return; }
+
+		const int position = m_vMoves.back().getPosition();
+		const Color c = m_vBoard[position];
+		const int line = m_lineIndex[dir][position];
+		const int bit = m_lineBit[dir][position];
+		const unsigned int own = m_lineMask[c - 1][dir][line];
+		const unsigned int blocked = m_lineMask[AgainstColor(c) - 1][dir][line] | m_invalidLineMask[dir][line];
+
+		// find start point (at most 4 points before the last move, stop at opponent or boundary)
+		const unsigned int blockedBefore = blocked & ((1u << bit) - 1);
+		int start = max(bit - 4, blockedBefore ? 32 - __builtin_clz(blockedBefore) : 0);
+
+		// investigate the first four places of the first segment
+		if (blocked & (0xFu << start)) { return; }
+
+		// go through all segments (5 points) until the tail is blocked
+		for (int k = 0; k < 5; ++k, ++start) {
+			if (blocked & (1u << (start + 4))) { break; }
+
+			const unsigned int segment = 0x1Fu << start;
+			if (__builtin_popcount(own & segment) != 4) { continue; }
+
+			const int emptyID = getLinePosition(dir, line, __builtin_ctz(segment & ~own));
+			if (m_currentThreat != -1 && m_currentThreat != emptyID) {
+				m_winner = c;
+				return;
 			}
+			m_currentThreat = emptyID;
 		}
-		if (chessCount >= 5) { 
-      m_winner = c;
-      return;
-    }
-  }
-
+	}
 
-  inline void updateThreat() {
-    m_threatRecord.push_back(m_currentThreat);
-    m_currentThreat = -1;
-    // row
-    updateLineThreat(0, 1);
-    // column
-    updateLineThreat(1, 0);
-    // diagonal (left-up to right-down)
-    updateLineThreat(1, 1);
-    // diagonal (left-down to right-up)
-    updateLineThreat(-1, 1);
-  }
+	inline void toggleLineBit(int position, Color c) {
+		for (int dir = 0; dir < NUM_LINE_DIRECTION; ++dir) { m_lineMask[c - 1][dir][m_lineIndex[dir][position]] ^= (1u << m_lineBit[dir][position]); }
+	}
 
-  inline void updateLineThreat(int di, int dj) {
-    if(m_winner != COLOR_NONE) { return; }
-		const int lastMoveIndex = m_vMoves.back().getPosition();
-    const int i = lastMoveIndex / getBoardSize();
-    const int j = lastMoveIndex % getBoardSize();
-		const Color c = m_vBoard[lastMoveIndex];
-		const Color opponent = (c == COLOR_BLACK ? COLOR_WHITE : COLOR_BLACK);
-    
-    int si = i, sj = j;
-    // find start point
-    for (int k = 0; k < 4; k++) {
-      if (si - di < 0 || si - di >= getBoardSize() ||
-          sj - dj < 0 || sj - dj >= getBoardSize() ||
-
-          m_vBoard[to1DIndex(si - di, sj - dj)] == opponent) {
-        break;
-      }
-      si -= di;
-      sj -= dj;
-    }
-    //investigate the first four place of the first segment
-    int ti = si, tj = sj;
-    int pieceCount = 0, emptyID = -1;
-    for (int k = 0; k < 4; k++) {
-      if (ti < 0 || ti >= getBoardSize() ||
-          tj < 0 || tj >= getBoardSize() ||
-          m_vBoard[to1DIndex(ti, tj)] == opponent) {
-        //no legal segment
-        return;
-      }
-      if (m_vBoard[to1DIndex(ti, tj)] == c) {
-        pieceCount++;
-      }
-      else {
-        emptyID = to1DIndex(ti, tj);
-      }
-      ti += di;
-      tj += dj;
-    }
-    //go through all segments by adding tail and removing head
-    for (int k = 0; k < 5; k++) {
-      if (ti < 0 || ti >= getBoardSize() ||
-          tj < 0 || tj >= getBoardSize() ||
-          m_vBoard[to1DIndex(ti, tj)] == opponent) {
-        break;
-      }
-      if (m_vBoard[to1DIndex(ti, tj)] == c) {
-        pieceCount++;
-      }
-      else {
-        emptyID = to1DIndex(ti, tj);
-      }
-      if (pieceCount == 4) {
-        if(m_currentThreat != -1 && m_currentThreat != emptyID) {
-          m_winner = c;
-          return;
-        }
-        m_currentThreat = emptyID;
-      }
-      if (m_vBoard[to1DIndex(si, sj)] == c) {
-        pieceCount--;
-      }
-      si += di;
-      sj += dj;
-      ti += di;
-      tj += dj;
-    }
-  }
+	// line directions: row (0,1), column (1,0), diagonal (1,1), anti-diagonal (-1,1)
+	static inline int getLinePosition(int dir, int line, int bit) {
+		switch (dir) {
+		case 0: return line * getBoardSize() + bit;
+		case 1: return bit * getBoardSize() + line;
+		case 2: return (line - (getBoardSize() - 1) + bit) * getBoardSize() + bit;
+		case 3: return (line - bit) * getBoardSize() + bit;
+		default: assert(("Invalid line direction", false));
+		}
+		return -1;
+	}
 
   inline void undoThreat() {
     m_currentThreat = m_threatRecord.back();
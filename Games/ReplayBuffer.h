@@ -0,0 +1,547 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "GameBase.h"
+#include "SgfLoader.h"
+
+using namespace std;
+
+/*!
+	@brief  binary self-play records, one file per iteration
+	        file   = ReplayFileHeader, record, record, ...
+	        record = uint32 payload size, ReplayRecordHeader, ReplayMove[numMoves], ReplayVisit[numVisits]
+	        every field is 4-byte aligned in native byte order, so a mapped file is read in place
+*/
+const char REPLAY_FILE_MAGIC[4] = { 'M', 'Z', 'R', 'B' };
+const uint32_t REPLAY_FILE_VERSION = 1;
+const char REPLAY_INDEX_MAGIC[4] = { 'M', 'Z', 'R', 'I' };
+const uint32_t REPLAY_INDEX_VERSION = 2;
+const char REPLAY_FEATURE_MAGIC[4] = { 'M', 'Z', 'R', 'F' };
+const uint32_t REPLAY_FEATURE_VERSION = 1;
+
+struct ReplayFileHeader {
+	char m_magic[4];
+	uint32_t m_version;
+};
+
+struct ReplayRecordHeader {
+	uint32_t m_numMoves;
+	uint32_t m_numVisits;
+	int32_t m_result;
+};
+
+struct ReplayMove {
+	int16_t m_position;
+	int16_t m_color;
+	int32_t m_branchingFactor;
+	uint32_t m_visitStart;
+	uint32_t m_numVisits;
+};
+
+struct ReplayVisit {
+	int32_t m_position;
+	int32_t m_count;
+};
+
+class ReplayRecordView {
+	const ReplayRecordHeader* m_pHeader;
+	const ReplayMove* m_pMoves;
+	const ReplayVisit* m_pVisits;
+
+public:
+	ReplayRecordView() : m_pHeader(nullptr), m_pMoves(nullptr), m_pVisits(nullptr) {}
+	ReplayRecordView(const char* pPayload)
+		: m_pHeader(reinterpret_cast<const ReplayRecordHeader*>(pPayload))
+		, m_pMoves(reinterpret_cast<const ReplayMove*>(pPayload + sizeof(ReplayRecordHeader)))
+		, m_pVisits(reinterpret_cast<const ReplayVisit*>(m_pMoves + m_pHeader->m_numMoves))
+	{
+	}
+
+	inline int getNumMoves() const { return m_pHeader->m_numMoves; }
+	inline Color getResult() const { return static_cast<Color>(m_pHeader->m_result); }
+	inline const ReplayMove& getMove(int index) const { return m_pMoves[index]; }
+	inline const ReplayVisit* getVisits(const ReplayMove& move) const { return m_pVisits + move.m_visitStart; }
+};
+
+class ReplayRecord {
+	Color m_result;
+	vector<ReplayMove> m_vMoves;
+	vector<ReplayVisit> m_vVisits;
+
+public:
+	ReplayRecord() { clear(); }
+
+	inline void clear()
+	{
+		m_result = COLOR_NONE;
+		m_vMoves.clear();
+		m_vVisits.clear();
+	}
+
+	// comment of each move is "position:count,...%branching_factor", detail after '*' should be removed before
+	bool parseFromSgf(const SgfLoader& sgfLoader, int boardSize)
+	{
+		clear();
+		m_result = charToColor(sgfLoader.getTag("RE").empty() ? 'N' : sgfLoader.getTag("RE")[0]);
+
+		const vector<SgfNode>& vNode = sgfLoader.getSgfNode();
+		for (size_t i = 1; i < vNode.size(); ++i) {
+			if (vNode[i].m_move.first.empty()) { return false; }
+
+			_Move move(vNode[i].m_move, boardSize);
+			ReplayMove replayMove;
+			replayMove.m_position = move.getPosition();
+			replayMove.m_color = move.getColor();
+			replayMove.m_branchingFactor = 0;
+			replayMove.m_visitStart = m_vVisits.size();
+
+			const string& sComment = vNode[i].m_comment;
+			size_t end = sComment.find('%');
+			if (end != string::npos) { replayMove.m_branchingFactor = atoi(sComment.c_str() + end + 1); }
+			else { end = sComment.length(); }
+
+			size_t start = 0;
+			while (start < end) {
+				size_t next = min(sComment.find(',', start), end);
+				size_t split = sComment.find(':', start);
+				if (split < next) { m_vVisits.push_back({ atoi(sComment.c_str() + start), atoi(sComment.c_str() + split + 1) }); }
+				start = next + 1;
+			}
+			replayMove.m_numVisits = m_vVisits.size() - replayMove.m_visitStart;
+			m_vMoves.push_back(replayMove);
+		}
+
+		return true;
+	}
+
+	string toBinaryString() const
+	{
+		ReplayRecordHeader header;
+		header.m_numMoves = m_vMoves.size();
+		header.m_numVisits = m_vVisits.size();
+		header.m_result = m_result;
+
+		uint32_t size = sizeof(ReplayRecordHeader) + m_vMoves.size() * sizeof(ReplayMove) + m_vVisits.size() * sizeof(ReplayVisit);
+		string sBinary;
+		sBinary.reserve(sizeof(uint32_t) + size);
+		sBinary.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+		sBinary.append(reinterpret_cast<const char*>(&header), sizeof(ReplayRecordHeader));
+		sBinary.append(reinterpret_cast<const char*>(m_vMoves.data()), m_vMoves.size() * sizeof(ReplayMove));
+		sBinary.append(reinterpret_cast<const char*>(m_vVisits.data()), m_vVisits.size() * sizeof(ReplayVisit));
+		return sBinary;
+	}
+
+	static string getFileHeaderString()
+	{
+		ReplayFileHeader header;
+		memcpy(header.m_magic, REPLAY_FILE_MAGIC, sizeof(REPLAY_FILE_MAGIC));
+		header.m_version = REPLAY_FILE_VERSION;
+		return string(reinterpret_cast<const char*>(&header), sizeof(ReplayFileHeader));
+	}
+};
+
+/*!
+	@brief  read-only shared mapping of a whole file, pages are shared by all processes mapping the same file
+*/
+class MappedFile {
+	char* m_pData;
+	size_t m_size;
+
+public:
+	MappedFile() : m_pData(nullptr), m_size(0) {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const string& sFileName)
+	{
+		close();
+
+		int fd = ::open(sFileName.c_str(), O_RDONLY);
+		if (fd == -1) { return false; }
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) == -1 || fileStat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+
+		void* pData = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (pData == MAP_FAILED) { return false; }
+
+		m_pData = static_cast<char*>(pData);
+		m_size = fileStat.st_size;
+		return true;
+	}
+
+	void close()
+	{
+		if (m_pData) { munmap(m_pData, m_size); }
+		m_pData = nullptr;
+		m_size = 0;
+	}
+
+	inline bool isOpen() const { return m_pData != nullptr; }
+	inline const char* getData() const { return m_pData; }
+	inline size_t getSize() const { return m_size; }
+};
+
+/*!
+	@brief  read-only mapping of a replay file, records are located by walking the size prefixes once
+*/
+class ReplayBufferFile {
+	string m_sFileName;
+	MappedFile m_file;
+	vector<size_t> m_vRecordOffsets;
+
+public:
+	ReplayBufferFile() {}
+
+	bool open(const string& sFileName, bool bFindRecords = true)
+	{
+		close();
+		m_sFileName = sFileName;
+		if (!m_file.open(sFileName)) { return false; }
+
+		const ReplayFileHeader* pHeader = reinterpret_cast<const ReplayFileHeader*>(m_file.getData());
+		if (m_file.getSize() < sizeof(ReplayFileHeader) || memcmp(pHeader->m_magic, REPLAY_FILE_MAGIC, sizeof(REPLAY_FILE_MAGIC)) != 0 || pHeader->m_version != REPLAY_FILE_VERSION) {
+			cerr << "[ReplayBufferFile] unknown format: " << sFileName << endl;
+			close();
+			return false;
+		}
+		if (!bFindRecords) { return true; }
+
+		// a partially written record at the end of file is ignored
+		size_t offset = sizeof(ReplayFileHeader);
+		while (offset + sizeof(uint32_t) <= m_file.getSize()) {
+			uint32_t size = *reinterpret_cast<const uint32_t*>(m_file.getData() + offset);
+			offset += sizeof(uint32_t);
+			if (offset + size > m_file.getSize()) { break; }
+
+			m_vRecordOffsets.push_back(offset);
+			offset += size;
+		}
+
+		return true;
+	}
+
+	void close()
+	{
+		m_file.close();
+		m_vRecordOffsets.clear();
+	}
+
+	// each line of a self-play sgf file is "game_id move_number sgf", the sgf should have no detail after '*'
+	static bool convertFromSgf(const string& sSgfFileName, const string& sReplayFileName, int boardSize)
+	{
+		ifstream fSgf(sSgfFileName.c_str());
+		if (!fSgf) { return false; }
+
+		string sTempFileName = sReplayFileName + ".tmp";
+		ofstream fReplay(sTempFileName.c_str(), ios::out | ios::binary);
+		fReplay << ReplayRecord::getFileHeaderString();
+
+		string sLine;
+		int numGames = 0, numFailed = 0;
+		while (getline(fSgf, sLine)) {
+			if (sLine.find("(") == string::npos) { continue; }
+
+			SgfLoader sgfLoader;
+			ReplayRecord replayRecord;
+			if (sgfLoader.parseFromString(sLine.substr(sLine.find("("))) && replayRecord.parseFromSgf(sgfLoader, boardSize)) {
+				fReplay << replayRecord.toBinaryString();
+				++numGames;
+			} else {
+				++numFailed;
+			}
+		}
+
+		fReplay.close();
+		if (!fReplay || rename(sTempFileName.c_str(), sReplayFileName.c_str()) != 0) {
+			cerr << "[ReplayBufferFile] Failed to write " << sReplayFileName << endl;
+			return false;
+		}
+
+		cerr << "[ReplayBufferFile] Convert " << numGames << " games from " << sSgfFileName << " to " << sReplayFileName;
+		if (numFailed > 0) { cerr << ", " << numFailed << " games failed"; }
+		cerr << endl;
+		return true;
+	}
+
+	inline string getFileName() const { return m_sFileName; }
+	inline int getNumRecords() const { return m_vRecordOffsets.size(); }
+	inline size_t getRecordOffset(int index) const { return m_vRecordOffsets[index]; }
+	inline ReplayRecordView getRecord(int index) const { return getRecordAtOffset(m_vRecordOffsets[index]); }
+	inline ReplayRecordView getRecordAtOffset(size_t offset) const { return ReplayRecordView(m_file.getData() + offset); }
+	inline size_t getSize() const { return m_file.getSize(); }
+};
+
+/*!
+	@brief  bit-packed input features (SYM_NORMAL) of every position in a replay file, built once for each iteration
+	        file = ReplayFeatureHeader, uint64[numWords] of each position of each record in record order
+	        a sampled position is read directly instead of replaying its game from the first move
+*/
+struct ReplayFeatureHeader {
+	char m_magic[4];
+	uint32_t m_version;
+	uint32_t m_featureSize;
+	uint32_t m_numWords;
+	uint64_t m_replayFileSize;
+	uint64_t m_numPositions;
+};
+
+class ReplayFeatureFile {
+	MappedFile m_file;
+	const ReplayFeatureHeader* m_pHeader;
+	const uint64_t* m_pWords;
+
+public:
+	ReplayFeatureFile() : m_pHeader(nullptr), m_pWords(nullptr) {}
+
+	static string getFileName(const string& sReplayFileName) { return sReplayFileName.substr(0, sReplayFileName.find_last_of('.')) + ".feat"; }
+
+	// features are binary, so each feature is one bit
+	template<class _Game, class _Move> static bool build(const ReplayBufferFile& replayFile)
+	{
+		const int featureSize = _Game::getNumChannels() * _Game::getBoardSize() * _Game::getBoardSize();
+		ReplayFeatureHeader header;
+		memcpy(header.m_magic, REPLAY_FEATURE_MAGIC, sizeof(REPLAY_FEATURE_MAGIC));
+		header.m_version = REPLAY_FEATURE_VERSION;
+		header.m_featureSize = featureSize;
+		header.m_numWords = (featureSize + 63) / 64;
+		header.m_replayFileSize = replayFile.getSize();
+		header.m_numPositions = 0;
+		for (int i = 0; i < replayFile.getNumRecords(); ++i) { header.m_numPositions += replayFile.getRecord(i).getNumMoves(); }
+
+		string sFeatureFileName = getFileName(replayFile.getFileName());
+		string sTempFileName = sFeatureFileName + ".tmp";
+		ofstream fFeature(sTempFileName.c_str(), ios::out | ios::binary);
+		fFeature.write(reinterpret_cast<const char*>(&header), sizeof(ReplayFeatureHeader));
+
+		_Game game;
+		vector<float> vFeatures(featureSize);
+		vector<uint64_t> vWords(header.m_numWords);
+		for (int i = 0; i < replayFile.getNumRecords(); ++i) {
+			ReplayRecordView record = replayFile.getRecord(i);
+			game.reset();
+			for (int j = 0; j < record.getNumMoves(); ++j) {
+				game.getFeatures(vFeatures.data(), SYM_NORMAL);
+				fill(vWords.begin(), vWords.end(), 0);
+				for (int k = 0; k < featureSize; ++k) {
+					assert(("Features should be binary to be packed as bits", vFeatures[k] == 0.0f || vFeatures[k] == 1.0f));
+					vWords[k / 64] |= static_cast<uint64_t>(vFeatures[k] != 0.0f) << (k % 64);
+				}
+				fFeature.write(reinterpret_cast<const char*>(vWords.data()), vWords.size() * sizeof(uint64_t));
+
+				// the last move is never played since no position is sampled after it
+				if (j + 1 < record.getNumMoves()) { game.play(_Move(static_cast<Color>(record.getMove(j).m_color), record.getMove(j).m_position)); }
+			}
+		}
+
+		fFeature.close();
+		if (!fFeature || rename(sTempFileName.c_str(), sFeatureFileName.c_str()) != 0) {
+			cerr << "[ReplayFeatureFile] Failed to write " << sFeatureFileName << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// fails if the replay file is changed after the features are built
+	bool open(const ReplayBufferFile& replayFile, bool bShowError = true)
+	{
+		close();
+
+		string sFeatureFileName = getFileName(replayFile.getFileName());
+		if (!m_file.open(sFeatureFileName)) { return false; }
+
+		m_pHeader = reinterpret_cast<const ReplayFeatureHeader*>(m_file.getData());
+		if (m_file.getSize() < sizeof(ReplayFeatureHeader) || memcmp(m_pHeader->m_magic, REPLAY_FEATURE_MAGIC, sizeof(REPLAY_FEATURE_MAGIC)) != 0
+			|| m_pHeader->m_version != REPLAY_FEATURE_VERSION || m_pHeader->m_replayFileSize != replayFile.getSize()
+			|| m_file.getSize() != sizeof(ReplayFeatureHeader) + m_pHeader->m_numPositions * m_pHeader->m_numWords * sizeof(uint64_t)) {
+			if (bShowError) { cerr << "[ReplayFeatureFile] out of date or unknown format: " << sFeatureFileName << endl; }
+			close();
+			return false;
+		}
+		m_pWords = reinterpret_cast<const uint64_t*>(m_file.getData() + sizeof(ReplayFeatureHeader));
+
+		return true;
+	}
+
+	void close()
+	{
+		m_file.close();
+		m_pHeader = nullptr;
+		m_pWords = nullptr;
+	}
+
+	inline bool isOpen() const { return m_pHeader != nullptr; }
+	inline int getFeatureSize() const { return m_pHeader->m_featureSize; }
+	inline int getNumWords() const { return m_pHeader->m_numWords; }
+	inline uint64_t getNumPositions() const { return m_pHeader->m_numPositions; }
+	inline const uint64_t* getFeatures(uint64_t position) const { return m_pWords + position * m_pHeader->m_numWords; }
+};
+
+/*!
+	@brief  index of the records of replay files [start, end], built once and then mapped read-only by every data loader
+	        index = ReplayIndexHeader, ReplayIndexEntry[numRecords]
+	        entries keep the prefix sum of positions for picking a uniformly random position by binary search
+*/
+struct ReplayIndexHeader {
+	char m_magic[4];
+	uint32_t m_version;
+	int32_t m_start;
+	int32_t m_end;
+	uint64_t m_numRecords;
+};
+
+struct ReplayIndexEntry {
+	int32_t m_iteration;
+	uint32_t m_reserved;
+	uint64_t m_offset;
+	uint64_t m_featurePosition;
+	int64_t m_dataSize;
+};
+
+class ReplayBufferIndex {
+	MappedFile m_indexFile;
+	const ReplayIndexHeader* m_pHeader;
+	const ReplayIndexEntry* m_pEntries;
+	vector<unique_ptr<ReplayBufferFile>> m_vReplayFiles;
+	vector<unique_ptr<ReplayFeatureFile>> m_vFeatureFiles;
+
+public:
+	ReplayBufferIndex() : m_pHeader(nullptr), m_pEntries(nullptr) {}
+
+	static string getReplayFileName(const string& sTrainDir, int iteration) { return sTrainDir + "/replay/" + to_string(iteration) + ".bin"; }
+	static string getSgfFileName(const string& sTrainDir, int iteration) { return sTrainDir + "/sgf/" + to_string(iteration) + ".sgf"; }
+	static string getIndexFileName(const string& sTrainDir, int start, int end) { return sTrainDir + "/replay/index_" + to_string(start) + "_" + to_string(end) + ".idx"; }
+
+	// written to a temporary file and renamed, so readers never see a partial index
+	// features of the replay files which have no up-to-date feature file are built as well
+	// iterations played before replay files were written only have sgf files, they are converted first
+	template<class _Game, class _Move> static bool build(const string& sTrainDir, int start, int end)
+	{
+		mkdir((sTrainDir + "/replay").c_str(), 0755);
+
+		ReplayIndexHeader header;
+		memcpy(header.m_magic, REPLAY_INDEX_MAGIC, sizeof(REPLAY_INDEX_MAGIC));
+		header.m_version = REPLAY_INDEX_VERSION;
+		header.m_start = start;
+		header.m_end = end;
+		header.m_numRecords = 0;
+
+		int64_t dataSize = 0;
+		vector<ReplayIndexEntry> vEntries;
+		for (int i = start; i <= end; ++i) {
+			string sReplayFileName = getReplayFileName(sTrainDir, i);
+			if (access(sReplayFileName.c_str(), F_OK) != 0) { ReplayBufferFile::convertFromSgf(getSgfFileName(sTrainDir, i), sReplayFileName, _Game::getBoardSize()); }
+
+			ReplayBufferFile replayFile;
+			if (!replayFile.open(sReplayFileName)) {
+				cerr << "[ReplayBufferIndex] Failed to open replay file of iteration " << i << endl;
+				continue;
+			}
+
+			ReplayFeatureFile featureFile;
+			if (!featureFile.open(replayFile, false) && !ReplayFeatureFile::build<_Game, _Move>(replayFile)) { return false; }
+
+			uint64_t featurePosition = 0;
+			for (int j = 0; j < replayFile.getNumRecords(); ++j) {
+				int numMoves = replayFile.getRecord(j).getNumMoves();
+				if (numMoves == 0) { continue; }
+
+				dataSize += numMoves;
+				vEntries.push_back({ i, 0, replayFile.getRecordOffset(j), featurePosition, dataSize });
+				featurePosition += numMoves;
+			}
+		}
+		header.m_numRecords = vEntries.size();
+
+		string sIndexFileName = getIndexFileName(sTrainDir, start, end);
+		string sTempFileName = sIndexFileName + ".tmp";
+		ofstream fIndex(sTempFileName.c_str(), ios::out | ios::binary);
+		fIndex.write(reinterpret_cast<const char*>(&header), sizeof(ReplayIndexHeader));
+		fIndex.write(reinterpret_cast<const char*>(vEntries.data()), vEntries.size() * sizeof(ReplayIndexEntry));
+		fIndex.close();
+		if (!fIndex || rename(sTempFileName.c_str(), sIndexFileName.c_str()) != 0) {
+			cerr << "[ReplayBufferIndex] Failed to write " << sIndexFileName << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool open(const string& sTrainDir, int start, int end)
+	{
+		close();
+
+		string sIndexFileName = getIndexFileName(sTrainDir, start, end);
+		if (!m_indexFile.open(sIndexFileName)) { return false; }
+
+		m_pHeader = reinterpret_cast<const ReplayIndexHeader*>(m_indexFile.getData());
+		if (m_indexFile.getSize() < sizeof(ReplayIndexHeader) || memcmp(m_pHeader->m_magic, REPLAY_INDEX_MAGIC, sizeof(REPLAY_INDEX_MAGIC)) != 0
+			|| m_pHeader->m_version != REPLAY_INDEX_VERSION || m_indexFile.getSize() != sizeof(ReplayIndexHeader) + m_pHeader->m_numRecords * sizeof(ReplayIndexEntry)) {
+			cerr << "[ReplayBufferIndex] unknown format: " << sIndexFileName << endl;
+			close();
+			return false;
+		}
+		m_pEntries = reinterpret_cast<const ReplayIndexEntry*>(m_indexFile.getData() + sizeof(ReplayIndexHeader));
+
+		// replay files are mapped without walking their records, the index already has the offsets
+		for (int i = start; i <= end; ++i) {
+			m_vReplayFiles.push_back(unique_ptr<ReplayBufferFile>(new ReplayBufferFile()));
+			m_vFeatureFiles.push_back(unique_ptr<ReplayFeatureFile>(new ReplayFeatureFile()));
+			if (m_vReplayFiles.back()->open(getReplayFileName(sTrainDir, i), false)) { m_vFeatureFiles.back()->open(*m_vReplayFiles.back()); }
+		}
+		for (uint64_t i = 0; i < m_pHeader->m_numRecords; ++i) {
+			const ReplayBufferFile& replayFile = *m_vReplayFiles[m_pEntries[i].m_iteration - start];
+			const ReplayFeatureFile& featureFile = *m_vFeatureFiles[m_pEntries[i].m_iteration - start];
+			int64_t numMoves = m_pEntries[i].m_dataSize - (i == 0 ? 0 : m_pEntries[i - 1].m_dataSize);
+			if (m_pEntries[i].m_offset < replayFile.getSize() && featureFile.isOpen()
+				&& m_pEntries[i].m_featurePosition + numMoves <= featureFile.getNumPositions()) { continue; }
+
+			cerr << "[ReplayBufferIndex] index is out of date: " << sIndexFileName << endl;
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void close()
+	{
+		m_indexFile.close();
+		m_pHeader = nullptr;
+		m_pEntries = nullptr;
+		m_vReplayFiles.clear();
+		m_vFeatureFiles.clear();
+	}
+
+	inline int getNumRecords() const { return m_pHeader ? m_pHeader->m_numRecords : 0; }
+	inline int64_t getDataSize() const { return getNumRecords() == 0 ? 0 : m_pEntries[getNumRecords() - 1].m_dataSize; }
+	inline int64_t getDataSize(int index) const { return m_pEntries[index].m_dataSize; }
+	inline ReplayRecordView getRecord(int index) const
+	{
+		return m_vReplayFiles[m_pEntries[index].m_iteration - m_pHeader->m_start]->getRecordAtOffset(m_pEntries[index].m_offset);
+	}
+	inline int getFeatureSize() const { return getNumRecords() == 0 ? 0 : m_vFeatureFiles[m_pEntries[0].m_iteration - m_pHeader->m_start]->getFeatureSize(); }
+	inline const uint64_t* getFeatures(int index, int moveIndex) const
+	{
+		return m_vFeatureFiles[m_pEntries[index].m_iteration - m_pHeader->m_start]->getFeatures(m_pEntries[index].m_featurePosition + moveIndex);
+	}
+};
@@ -52,6 +52,13 @@ public:
 		return false;
 	}
 
+	void getLegalMoveMask(int* pLegalMove, int* pBadMove) const {
+		for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
+			pLegalMove[pos] = isLegalMove(TieTacToeMove(m_turnColor, pos));
+			pBadMove[pos] = false;
+		}
+	}
+
 	inline bool isTerminal() {
 		// terminal: all points are played by "O" or "X" || any player wins
 		return (eval() != COLOR_NONE || find(m_vBoard.begin(), m_vBoard.end(), COLOR_NONE) == m_vBoard.end());
@@ -129,18 +136,22 @@ public:
 	}
 
 	vector<float> getFeatures(SymmetryType type = SYM_NORMAL) const {
-		vector<float> vFeatures;
+		vector<float> vFeatures(getNumChannels() * getMaxNumLegalAction());
+		getFeatures(vFeatures.data(), type);
+		return vFeatures;
+	}
+
+	void getFeatures(float* pFeatures, SymmetryType type = SYM_NORMAL) const {
 		// 4 feature planes (Black Board/White Board/Turn Color)
 		for (int channel = 0; channel < getNumChannels(); ++channel) {
 			for (int pos = 0; pos < getMaxNumLegalAction(); ++pos) {
 				int rotatePos = getRotatePosition(pos, getBoardSize(), ReverseSymmetricType[type]);
-				if (channel == 0) { vFeatures.push_back((m_vBoard[rotatePos] == m_turnColor ? 1.0f : 0.0f)); }
-				else if (channel == 1) { vFeatures.push_back((m_vBoard[rotatePos] == AgainstColor(m_turnColor) ? 1.0f : 0.0f)); }
-				else if (channel == 2) { vFeatures.push_back((m_turnColor == COLOR_BLACK ? 1.0f : 0.0f)); }
-				else if (channel == 3) { vFeatures.push_back((m_turnColor == COLOR_WHITE ? 1.0f : 0.0f)); }
+				if (channel == 0) { *pFeatures++ = (m_vBoard[rotatePos] == m_turnColor ? 1.0f : 0.0f); }
+				else if (channel == 1) { *pFeatures++ = (m_vBoard[rotatePos] == AgainstColor(m_turnColor) ? 1.0f : 0.0f); }
+				else if (channel == 2) { *pFeatures++ = (m_turnColor == COLOR_BLACK ? 1.0f : 0.0f); }
+				else if (channel == 3) { *pFeatures++ = (m_turnColor == COLOR_WHITE ? 1.0f : 0.0f); }
 			}
 		}
-		return vFeatures;
 	}
 
 	// overwrite static function
@@ -1,10 +1,12 @@
 #include "BaseMCTS.h"
 #include "Random.h"
 #include "TimeSystem.h"
+#include "PUCTSelector.h"
 #include <iomanip>
 
 void BaseMCTS::newGame()
 {
+	m_pReuseRoot = nullptr;
 	newTree();
 	m_game.reset();
 }
@@ -32,7 +34,16 @@ Move BaseMCTS::run(Color c, bool bWithPlay/* = true*/)
 
 void BaseMCTS::play(const Move& move)
 {
+	// keep the child of the played move, it becomes the root of next tree
+	m_pReuseRoot = nullptr;
+	TreeNode* pRoot = getRootNode();
+	TreeNode* pChild = pRoot->getFirstChild();
+	for (int i = 0; i < pRoot->getNumChild(); ++i, ++pChild) {
+		if (pChild->getMove().getColor() == move.getColor() && pChild->getMove().getPosition() == move.getPosition()) { m_pReuseRoot = pChild; break; }
+	}
+
 	m_game.play(move);
+	m_reuseMoveSize = m_game.getMoves().size();
 }
 
 void BaseMCTS::selection()
@@ -51,22 +62,29 @@ void BaseMCTS::expansion()
 {
 	if (m_game.isTerminal()) { return; }
 
-	const vector<pair<Move, float>>& vProbability = getProbability();
-	TreeNode* pParent = m_vSelectNodePath.back();
-	TreeNode* pChild = allocateNewNodes(vProbability.size());
+	expandNode(m_vSelectNodePath.back(), m_game, getProbability());
+}
 
-	// assign info to parent node
-	pParent->setFirstChild(pChild);
-	pParent->setNumChild(vProbability.size());
+void BaseMCTS::expandNode(TreeNode* pParent, Game& game, const vector<pair<Move, float>>& vProbability)
+{
+	const int nChild = static_cast<int>(vProbability.size());
+	TreeNode* pFirstChild = allocateNewNodes(nChild);
+	float* pChildStatData = m_arena[m_arenaIndex].allocateChildStat(nChild);
 
 	// assign policy to child nodes
-	for (auto p : vProbability) {
-		assert(("Expand illegal move", m_game.isLegalMove(p.first)));
-
-		pChild->reset(p.first);
-		pChild->setProbability(p.second);
-		pChild->setProbabilityWithNoise(p.second);
-		++pChild;
+	TreeNode* pChild = pFirstChild;
+	TreeNodeChildStat childStat(pChildStatData, nChild);
+	for (int i = 0; i < nChild; ++i, ++pChild) {
+		assert(("Expand illegal move", game.isLegalMove(vProbability[i].first)));
+
+		pChild->reset(vProbability[i].first);
+		pChild->setProbability(vProbability[i].second);
+		pChild->setProbabilityWithNoise(vProbability[i].second);
+		childStat.m_pPrior[i] = vProbability[i].second;
+		childStat.m_pSimCount[i] = 0.0f;
+		childStat.m_pCount[i] = 0.0f;
+		childStat.m_pMean[i] = 0.0f;
+		childStat.m_pFlag[i] = 0;
 	}
 
 	assert(("No child can be expanded", vProbability.size() > 0));
@@ -77,6 +95,12 @@ void BaseMCTS::expansion()
 	case 2:	default: break;
 	}
 
+	// assign info to parent node after children are ready, other threads may traverse it once the number of children is set
+	pParent->setFirstChild(pFirstChild);
+	pParent->setChildStatData(pChildStatData);
+	boost::atomic_thread_fence(boost::memory_order_release);
+	pParent->setNumChild(vProbability.size());
+
 	// add noise to root node
 	if (Configure::MCTS_USE_NOISE_AT_ROOT && pParent == getRootNode()) { addNoiseToChildren(pParent); }
 }
@@ -97,6 +121,7 @@ void BaseMCTS::update()
 			fValue = -fValue;
 		} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) { updateBySpaceComplexity(pNode, fValue); }
 		else { assert(("Error configuration for training value target!", false)); }
+		if (i > 0) { m_vSelectNodePath[i - 1]->syncChildStat(pNode); }
 	}
 }
 
@@ -104,11 +129,64 @@ void BaseMCTS::update()
 void BaseMCTS::newTree()
 {
 	m_simulation = 0;
-	m_nodeUsedIndex = 1;
 	m_backupMove = -1;
-	getRootNode()->reset(Move(AgainstColor(m_game.getTurnColor()), -1));
-	m_valueMap.clear();
+	m_valueBound.clear();
 	m_vSelectNodePath.clear();
+
+	if (!reuseTree()) {
+		m_arena[m_arenaIndex].clear();
+		m_pRoot = allocateNewNodes(1);
+		m_pRoot->reset(Move(AgainstColor(m_game.getTurnColor()), -1));
+	}
+	m_pReuseRoot = nullptr;
+	m_nSearchStartNode = m_arena[m_arenaIndex].getNumUsed();
+}
+
+bool BaseMCTS::reuseTree()
+{
+	// values of space complexity are calculated from the root's perspective, they can not be reused under another root
+	if (!Configure::MCTS_REUSE_TREE || !Configure::NET_VALUE_WINLOSS) { return false; }
+	if (m_pReuseRoot == nullptr || !m_pReuseRoot->hasChildren()) { return false; }
+	if (m_game.getMoves().size() != m_reuseMoveSize || AgainstColor(m_pReuseRoot->getMove().getColor()) != m_game.getTurnColor()) { return false; }
+
+	// the child becomes the root in place, nodes of the other moves are left in the arena until it is compacted
+	// compact by copying the subtree to the other arena only when the arena holds several searches of nodes
+	m_pRoot = m_pReuseRoot;
+	const long long nUsed = m_arena[m_arenaIndex].getNumUsed();
+	if (nUsed > REUSE_COMPACT_RATIO * (nUsed - m_nSearchStartNode)) {
+		m_arenaIndex = 1 - m_arenaIndex;
+		m_arena[m_arenaIndex].clear();
+		m_pRoot = allocateNewNodes(1);
+		*m_pRoot = *m_pReuseRoot;
+		copyChildren(m_pRoot);
+	}
+
+	if (Configure::MCTS_USE_NOISE_AT_ROOT) {
+		TreeNode* pChild = m_pRoot->getFirstChild();
+		for (int i = 0; i < m_pRoot->getNumChild(); ++i, ++pChild) { pChild->setProbabilityWithNoise(pChild->getProbability()); }
+		addNoiseToChildren(m_pRoot);
+	}
+
+	// simulations under the reused root are counted
+	m_simulation = min(static_cast<int>(m_pRoot->getUctData().getCount()), Configure::MCTS_SIMULATION_COUNT - 1);
+	return true;
+}
+
+void BaseMCTS::copyChildren(TreeNode* pNode)
+{
+	if (!pNode->hasChildren()) { return; }
+
+	TreeNode* pOldChild = pNode->getFirstChild();
+	TreeNode* pNewChild = allocateNewNodes(pNode->getNumChild());
+	for (int i = 0; i < pNode->getNumChild(); ++i) { pNewChild[i] = pOldChild[i]; }
+	pNode->setFirstChild(pNewChild);
+
+	const int nChildStatFloat = TreeNodeChildStat::getNumFloat(pNode->getNumChild());
+	float* pNewChildStat = m_arena[m_arenaIndex].allocateChildStat(pNode->getNumChild());
+	copy(pNode->getChildStatData(), pNode->getChildStatData() + nChildStatFloat, pNewChildStat);
+	pNode->setChildStatData(pNewChildStat);
+
+	for (int i = 0; i < pNode->getNumChild(); ++i) { copyChildren(&pNewChild[i]); }
 }
 
 TreeNode* BaseMCTS::decideMCTSAction()
@@ -148,7 +226,7 @@ float BaseMCTS::calculateInitQValue(TreeNode* pNode)
 		if (!pChild->hasChildren()) { continue; }
 
 		// we only consider the nodes which have been simulated
-		fSumOfChildWins += pChild->getPUCTValueQ(m_valueMap, -1, rootTurn);
+		fSumOfChildWins += pChild->getPUCTValueQ(m_valueBound, -1, rootTurn);
 		fSumOfChildSims += 1;
 	}
 
@@ -156,47 +234,97 @@ float BaseMCTS::calculateInitQValue(TreeNode* pNode)
 	return (fSumOfChildWins - 1) / (fSumOfChildSims + 1);
 }
 
-float BaseMCTS::calculateMoveScore(TreeNode* pNode, int nParentSim, float fInitQValue)
+TreeNode* BaseMCTS::selectChild(TreeNode* pNode)
 {
-	// U(s,a) = c_puct * sqrt(ln( N(s,b))) / N(s,a)
-	float fValueU = sqrt(2.) * sqrt(log(nParentSim) / (1. + pNode->getSimCount()));
+	return selectPUCTChild(pNode, false);
+}
+
+TreeNode* BaseMCTS::selectPUCTChild(TreeNode* pNode, bool bSkipSolved)
+{
+	assert(("Pass a null pointer to selectChild", pNode));
 
-	// U(s,a) = c_puct * P(s,a) * sqrt(sum of N(s,b)) / (1 + N(s,a))
+	// scratch arrays for PUCTSelector (thread local since MCTSSolver selects by multiple threads)
+	static thread_local PUCTChildren children;
+	const int nChild = pNode->getNumChild();
+	children.resize(nChild);
+
+	// Q(s,a) of all children from the packed statistics, FLT_MAX stands for the node which is not simulated yet
+	const TreeNodeChildStat childStat = pNode->getChildStat();
+	float* pValueQ = children.m_vValueQ.data();
+	if (Configure::NET_VALUE_WINLOSS) {
+		for (int i = 0; i < nChild; ++i) { pValueQ[i] = childStat.m_pMean[i]; }
+	} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
+		calculateSpaceComplexityValueQ(pNode, childStat, pValueQ);
+	} else { assert(("Error configuration for training value target!", false)); }
+
+	// simulations which are not backed up yet (by other threads) are regarded as losses
+	float fSumOfChildWins = 0.0f;
+	float fSumOfChildSims = 0.0f;
+	for (int i = 0; i < nChild; ++i) {
+		const float fSimCount = childStat.m_pSimCount[i];
+		const float fCount = childStat.m_pCount[i];
+		if (fSimCount == 0.0f) { pValueQ[i] = FLT_MAX; }
+		else if (fSimCount != fCount && pValueQ[i] != FLT_MAX) { pValueQ[i] = (pValueQ[i] * fCount - (fSimCount - fCount)) / fSimCount; }
+
+		if (childStat.m_pFlag[i] & TreeNodeChildStat::FLAG_EXPANDED) {
+			fSumOfChildWins += (pValueQ[i] == FLT_MAX) ? -1 : pValueQ[i];
+			fSumOfChildSims += 1;
+		}
+	}
+
+	// same as calculateInitQValue, add additional one loss for other uninitialized node
+	// solved children are skipped by the score of negative infinity (never selected by PUCTSelector)
+	const float fInitQValue = (fSumOfChildWins - 1) / (fSumOfChildSims + 1);
+	for (int i = 0; i < nChild; ++i) {
+		if (pValueQ[i] == FLT_MAX) { pValueQ[i] = fInitQValue; }
+		if (bSkipSolved && (childStat.m_pFlag[i] & TreeNodeChildStat::FLAG_SOLVED)) { pValueQ[i] = -numeric_limits<float>::infinity(); }
+	}
+
+	// U(s,a) = c_puct * P(s,a) * sqrt(sum of N(s,b)) / (1 + N(s,a)), c_puct * sqrt(sum of N(s,b)) is the same for all children
+	const int nParentSimulation = pNode->getSimCount();
+	const float* pPrior = childStat.m_pPrior;
+	const float* pCount = childStat.m_pSimCount;
+	float fScaleU = 1.0f;
 	if (Configure::USE_NET) {
-		float fValuePa = Configure::MCTS_USE_NOISE_AT_ROOT ? pNode->getProbabilityWithNoise() : pNode->getProbability();
-		float fPUCTBias = log((1 + nParentSim + 19652) / 19652) + Configure::MCTS_PUCT_BIAS;
+		float fPUCTBias = log((1 + nParentSimulation + 19652) / 19652) + Configure::MCTS_PUCT_BIAS;
 		fPUCTBias = (Configure::MCTS_PUCT_BIAS == 0 ? 0 : fPUCTBias);
-		fValueU = fPUCTBias * fValuePa * sqrt(nParentSim) / (1 + pNode->getSimCount());
+		fScaleU = fPUCTBias * sqrt(nParentSimulation);
+	} else {
+		// U(s,a) = c_puct * sqrt(ln( N(s,b))) / N(s,a), packed as prior with zero count
+		for (int i = 0; i < nChild; ++i) {
+			children.m_vPrior[i] = sqrt(2.) * sqrt(log(nParentSimulation) / (1. + childStat.m_pSimCount[i]));
+			children.m_vCount[i] = 0.0f;
+		}
+		pPrior = children.m_vPrior.data();
+		pCount = children.m_vCount.data();
 	}
 
-	// Q(s,a)
-	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
-	float fValueQ = pNode->getPUCTValueQ(m_valueMap, fInitQValue, rootTurn);
-
-	// action value = U(s,a) + Q(s,a)
-	return fValueU + Configure::MCTS_Q_WEIGHT * fValueQ;
+	int index = PUCTSelector::argmax(pPrior, pCount, pValueQ, nChild, fScaleU, Configure::MCTS_Q_WEIGHT);
+	return (index == -1) ? nullptr : pNode->getFirstChild() + index;
 }
 
-TreeNode* BaseMCTS::selectChild(TreeNode* pNode)
+void BaseMCTS::calculateSpaceComplexityValueQ(TreeNode* pNode, const TreeNodeChildStat& childStat, float* pValueQ)
 {
-	assert(("Pass a null pointer to selectChild", pNode));
-
-	TreeNode* pBest = nullptr;
-	TreeNode* pChild = pNode->getFirstChild();
-	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
-
-	float fBestScore = -DBL_MAX;
-	float fInitQValue = calculateInitQValue(pNode);
-	int nParentSimulation = pNode->getSimCount();
-	for (int i = 0; i < pNode->getNumChild(); ++i, ++pChild) {
-		float fMoveScore = calculateMoveScore(pChild, nParentSimulation, fInitQValue);
-		if (fMoveScore <= fBestScore) { continue; }
-
-		fBestScore = fMoveScore;
-		pBest = pChild;
+	const int nChild = pNode->getNumChild();
+	if (m_valueBound.empty()) {
+		for (int i = 0; i < nChild; ++i) { pValueQ[i] = FLT_MAX; }
+		return;
 	}
 
-	return pBest;
+	// since we want to minimize the space complexity, we should flip the win rate if the color is the same as proof color
+	// (all children are the moves of the same color)
+	const Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
+	const Color flipColor = (Configure::AOT_PROOF_COLOR == COLOR_NONE) ? rootTurn : Configure::AOT_PROOF_COLOR;
+	const float fSign = (pNode->getFirstChild()->getMove().getColor() == flipColor) ? -1.0f : 1.0f;
+
+	// normalize to [-1, 1] by value bound, the same as TreeNode::getNormalizedValueQ
+	const ValueBoundTracker::Bound bound = m_valueBound.getBound();
+	const float fDistance = bound.m_fUpper - bound.m_fLower;
+	for (int i = 0; i < nChild; ++i) {
+		float fValue = 0.0f;
+		if (fDistance != 0.0f && childStat.m_pCount[i] != 0.0f) { fValue = fmin(fmax(2 * ((childStat.m_pMean[i] - bound.m_fLower) / fDistance) - 1, -1), 1); }
+		pValueQ[i] = fSign * fValue;
+	}
 }
 
 void BaseMCTS::addNoiseToChildren(TreeNode* pNode)
@@ -204,8 +332,10 @@ void BaseMCTS::addNoiseToChildren(TreeNode* pNode)
 	const float fEpsilon = Configure::ZERO_NOISE_EPSILON;
 	vector<float> vDirichletNoise = calculateDirichletNoise(pNode->getNumChild(), Configure::ZERO_NOISE_ALPHA);
 	TreeNode* pChild = pNode->getFirstChild();
+	TreeNodeChildStat childStat = pNode->getChildStat();
 	for (int i = 0; i < pNode->getNumChild(); ++i, ++pChild) {
 		pChild->setProbabilityWithNoise((1 - fEpsilon) * pChild->getProbabilityWithNoise() + fEpsilon * vDirichletNoise[i]);
+		childStat.m_pPrior[i] = pChild->getProbabilityWithNoise();
 	}
 }
 
@@ -219,7 +349,7 @@ vector<float> BaseMCTS::calculateDirichletNoise(int size, float fAlpha)
 	for (int i = 0; i < size; i++) { vDirichlet.push_back(static_cast<float>(generator())); }
 	float fSum = accumulate(vDirichlet.begin(), vDirichlet.end(), 0.0f);
 	if (fSum < boost::numeric::bounds<float>::smallest()) { return vDirichlet; }
-	for (int i = 0; i < vDirichlet.size(); i++) { vDirichlet[i] /= fSum; }
+	for (size_t i = 0; i < vDirichlet.size(); i++) { vDirichlet[i] /= fSum; }
 	return vDirichlet;
 }
 
@@ -230,18 +360,13 @@ void BaseMCTS::updateByWinLose(TreeNode* pNode, float fValue)
 
 void BaseMCTS::updateBySpaceComplexity(TreeNode* pNode, float fValue)
 {
+	// the mean of node which is not simulated yet is not counted in value bound
+	bool bSimulated = (pNode->getUctData().getCount() > 0);
 	double dOld = pNode->getUctData().getMean();
 	pNode->getUctData().add(fValue);
-	updateValueMap(dOld, pNode->getUctData().getMean());
-}
 
-void BaseMCTS::updateValueMap(double dOldValue, double dValue)
-{
-	if (m_valueMap.find(dOldValue) != m_valueMap.end()) {
-		--m_valueMap[dOldValue];
-		if (m_valueMap[dOldValue] == 0) { m_valueMap.erase(dOldValue); }
-	}
-	++m_valueMap[dValue];
+	if (bSimulated) { m_valueBound.update(dOld, pNode->getUctData().getMean()); }
+	else { m_valueBound.add(pNode->getUctData().getMean()); }
 }
 
 string BaseMCTS::getMCTSSelectedMoveInfo(TreeNode* pSelected)
@@ -254,13 +379,13 @@ string BaseMCTS::getMCTSSelectedMoveInfo(TreeNode* pSelected)
 
 	oss << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[" << m_game.getMoves().size() << "] ";
 	oss << pSelected->getMove().toGtpString(Game::getBoardSize()) << " (" << pSelected->getUctData().toString();
-	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << ", " << pSelected->getPUCTValueQ(m_valueMap, -1, rootTurn) << "/" << pSelected->getSimCount(); }
+	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << ", " << pSelected->getPUCTValueQ(m_valueBound, -1, rootTurn) << "/" << pSelected->getSimCount(); }
 	oss << "), p: " << pSelected->getProbability();
 	if (Configure::MCTS_USE_NOISE_AT_ROOT) { oss << ", p_noise: " << pSelected->getProbabilityWithNoise(); }
 	oss << ", v: " << pSelected->getValue() << endl;
 
-	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << "Value Bound: (" << m_valueMap.begin()->first << "," << m_valueMap.rbegin()->first << "), "; }
-	oss << "Root: " << pRoot->getPUCTValueQ(m_valueMap, -1, rootTurn) << "/" << pRoot->getSimCount() << endl;
+	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << "Value Bound: (" << m_valueBound.getLowerBound() << "," << m_valueBound.getUpperBound() << "), "; }
+	oss << "Root: " << pRoot->getPUCTValueQ(m_valueBound, -1, rootTurn) << "/" << pRoot->getSimCount() << endl;
 
 	return oss.str();
 }
@@ -273,7 +398,7 @@ string BaseMCTS::getBestSequenceString(TreeNode* pSelected)
 	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
 	oss << colorToChar(pSelected->getMove().getColor()) << ","
 		<< pSelected->getMove().toGtpString(Game::getBoardSize()) << " "
-		<< "(" << pSelected->getPUCTValueQ(m_valueMap, -1, rootTurn)
+		<< "(" << pSelected->getPUCTValueQ(m_valueBound, -1, rootTurn)
 		<< "/" << pSelected->getSimCount() << ")";
 
 	while (pSelected->hasChildren()) {
@@ -287,7 +412,7 @@ string BaseMCTS::getBestSequenceString(TreeNode* pSelected)
 
 		oss << " => " << colorToChar(pSelected->getMove().getColor()) << ","
 			<< pSelected->getMove().toGtpString(Game::getBoardSize()) << " "
-			<< "(" << pSelected->getPUCTValueQ(m_valueMap, -1, rootTurn)
+			<< "(" << pSelected->getPUCTValueQ(m_valueBound, -1, rootTurn)
 			<< "/" << pSelected->getSimCount() << ")";
 	}
 
@@ -1,15 +1,37 @@
 #pragma once
 
 #include "TreeNode.h"
+#include "TreeNodeArena.h"
 
 class BaseMCTS {
 protected:
+	// scratch arrays for PUCTSelector, they only grow
+	class PUCTChildren {
+	public:
+		vector<float> m_vPrior;
+		vector<float> m_vCount;
+		vector<float> m_vValueQ;
+
+		inline void resize(int size) {
+			if (static_cast<size_t>(size) <= m_vValueQ.size()) { return; }
+			m_vPrior.resize(size);
+			m_vCount.resize(size);
+			m_vValueQ.resize(size);
+		}
+	};
+
+	static const int REUSE_COMPACT_RATIO = 4;
+
 	int m_simulation;
-	long long m_nodeUsedIndex;
+	int m_arenaIndex;
+	long long m_nSearchStartNode;
 	int m_backupMove;
+	size_t m_reuseMoveSize;
 	Game m_game;
-	TreeNode* m_nodes;
-	map<double, int> m_valueMap;
+	TreeNode* m_pRoot;
+	TreeNode* m_pReuseRoot;
+	TreeNodeArena m_arena[2];
+	ValueBoundTracker m_valueBound;
 	vector<TreeNode*> m_vSelectNodePath;
 	
 	// output from neural network
@@ -18,13 +40,16 @@ protected:
 
 public:
 	BaseMCTS()
+		: m_arenaIndex(0)
+		, m_nSearchStartNode(0)
+		, m_reuseMoveSize(0)
+		, m_pRoot(nullptr)
+		, m_pReuseRoot(nullptr)
 	{
-		long long int nodeSize = 1 + static_cast<long long int>(Configure::MCTS_SIMULATION_COUNT) * Game::getMaxNumLegalAction();
-		m_nodes = new TreeNode[nodeSize];
 		newGame();
 	}
 
-	~BaseMCTS() { delete[] m_nodes; }
+	~BaseMCTS() {}
 
 	void newGame();
 	virtual Move run(Color c, bool bWithPlay = true);
@@ -39,21 +64,24 @@ public:
 	virtual inline bool isSimulationEnd() { return m_simulation >= Configure::MCTS_SIMULATION_COUNT; }
 	inline int getSimulation() const { return m_simulation; }
 	inline Game& getGame() { return m_game; }
-	inline TreeNode* getRootNode() { return &m_nodes[0]; }
+	inline TreeNode* getRootNode() { return m_pRoot; }
 	inline bool isEndGame() { return m_game.isTerminal(); }
 
 protected:
 	void newTree();
+	bool reuseTree();
+	void copyChildren(TreeNode* pNode);
+	void expandNode(TreeNode* pParent, Game& game, const vector<pair<Move, float>>& vProbability);
 
 	TreeNode* decideMCTSAction();
 	float calculateInitQValue(TreeNode* pNode);
-	float calculateMoveScore(TreeNode* pNode, int nParentSim, float fInitQValue);
 	virtual TreeNode* selectChild(TreeNode* pNode);
+	TreeNode* selectPUCTChild(TreeNode* pNode, bool bSkipSolved);
+	void calculateSpaceComplexityValueQ(TreeNode* pNode, const TreeNodeChildStat& childStat, float* pValueQ);
 	void addNoiseToChildren(TreeNode* pNode);
 	vector<float> calculateDirichletNoise(int size, float fAlpha);
 	void updateByWinLose(TreeNode* pNode, float fValue);
 	void updateBySpaceComplexity(TreeNode* pNode, float fValue);
-	void updateValueMap(double dOldValue, double dValue);
 	string getMCTSSelectedMoveInfo(TreeNode* pSelected);
 	string getBestSequenceString(TreeNode* pSelected);
 
@@ -62,14 +90,8 @@ protected:
 	inline void backupGame() { m_backupMove = m_game.getMoves().size(); }
 	inline void rollbackGame() {
 		assert(("Calling roll back without setting back up move", m_backupMove >= 0));
-		while (m_game.getMoves().size() > m_backupMove) { m_game.undo(); }
+		while (m_game.getMoves().size() > static_cast<size_t>(m_backupMove)) { m_game.undo(); }
 	}
 
-	inline TreeNode* allocateNewNodes(int size) {
-		assert(("Use more nodes than declared node size", m_nodeUsedIndex + size <= 1 + static_cast<long long int>(Configure::MCTS_SIMULATION_COUNT) * Game::getMaxNumLegalAction()));
-		//if (m_nodeUsedIndex / 1000000 != (m_nodeUsedIndex + size) / 1000000) { cerr << ((m_nodeUsedIndex + size) / 1000000) * 1000000 << endl; }
-		TreeNode* pNode = &m_nodes[m_nodeUsedIndex];
-		m_nodeUsedIndex += size;
-		return pNode;
-	}
+	inline TreeNode* allocateNewNodes(int size) { return m_arena[m_arenaIndex].allocate(size); }
 };
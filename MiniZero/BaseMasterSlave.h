@@ -20,10 +20,15 @@ public:
 	{
 		initialize();
 
-		while (!isOver()) {
+		// check isOver only after startRun, the master may set it right after the previous finishRun
+		bool bOver = false;
+		while (!bOver) {
 			m_barStart.wait();
-			reset();
-			doSlaveJob();
+			bOver = isOver();
+			if (!bOver) {
+				reset();
+				doSlaveJob();
+			}
 			m_barFinish.wait();
 		}
 	}
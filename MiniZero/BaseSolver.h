@@ -6,7 +6,7 @@
 #include "TranspositionTable.h"
 
 class BaseSolver {
-protected:
+public:
 	static const int SIM_CONTROL_COUNT = 0;
 	static const int SIM_CONTROL_TIME = 1;
 	static const int SIM_CONTROL_TT_NODE = 2;
@@ -16,14 +16,18 @@ protected:
 	boost::shared_ptr<boost::asio::io_service::strand> m_strand;
 	boost::shared_ptr<tcp::socket> m_socket;
 	boost::asio::streambuf m_buffer;
+	boost::asio::deadline_timer m_readTimer;
 	boost::atomic<bool> m_bIsEnd;
 	std::deque<std::string> m_msg_queue;
+	size_t m_payloadSize;
 
 public:
 	BaseWorkerStatus(boost::shared_ptr<tcp::socket> socket)
 		: m_strand(new boost::asio::io_service::strand(socket->get_io_service()))
 		, m_socket(socket)
+		, m_readTimer(socket->get_io_service())
 		, m_bIsEnd(false)
+		, m_payloadSize(0)
 	{
 	}
 
@@ -78,6 +82,13 @@ public:
 
 	void start_read()
 	{
+		// stop reading while the handler is busy, the worker is blocked by TCP flow control meanwhile
+		if (isReadPaused()) {
+			m_readTimer.expires_from_now(boost::posix_time::milliseconds(100));
+			m_readTimer.async_wait(boost::bind(&BaseWorkerStatus::handle_read_timer, shared_from_this(), boost::asio::placeholders::error));
+			return;
+		}
+
 		boost::asio::async_read_until(*m_socket,
 			m_buffer, '\n',
 			boost::bind(&BaseWorkerStatus::handle_read, shared_from_this(),
@@ -104,10 +115,44 @@ public:
 		std::getline(is, line);
 		handle_msg(line);
 
+		if (m_payloadSize > 0) { start_read_payload(); }
+		else { start_read(); }
+	}
+
+	// binary payload of m_payloadSize bytes following the current line, requested by handle_msg
+	void start_read_payload()
+	{
+		size_t remainSize = (m_payloadSize > m_buffer.size() ? m_payloadSize - m_buffer.size() : 0);
+		boost::asio::async_read(*m_socket,
+			m_buffer, boost::asio::transfer_exactly(remainSize),
+			boost::bind(&BaseWorkerStatus::handle_read_payload, shared_from_this(),
+				boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+	}
+
+	void handle_read_payload(const boost::system::error_code& error, size_t bytes_read)
+	{
+		if (error) {
+			do_close();
+			return;
+		}
+
+		std::string payload(boost::asio::buffers_begin(m_buffer.data()), boost::asio::buffers_begin(m_buffer.data()) + m_payloadSize);
+		m_buffer.consume(m_payloadSize);
+		m_payloadSize = 0;
+		handle_payload(payload);
+
+		start_read();
+	}
+
+	void handle_read_timer(const boost::system::error_code& error)
+	{
+		if (error || m_bIsEnd) { return; }
 		start_read();
 	}
 
 	virtual void handle_msg(const std::string msg) = 0;
+	virtual void handle_payload(const std::string& payload) {}
+	virtual bool isReadPaused() { return false; }
 	bool isEnd() { return m_bIsEnd; }
 };
 
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "SpinLock.h"
+
+typedef unsigned long long HashKey;
+
+/*!
+	@brief  hash table with fixed size buckets, a key can only be stored in its own bucket
+	        when the bucket is full, the replaceable entry with the least work is replaced
+	        _data keeps its own key check and free flag so that an entry is not padded by the table, it should provide
+	        clear(), isFree(), setKey(), hasKey(), isReplaceable() and getWork()
+	        each bucket has its own lock, entries should be accessed between lock() and unlock()
+*/
+template<class _data> class BucketHashTable {
+	typedef unsigned int IndexType;
+	static const int BUCKET_BIT_SIZE = 2;
+	static const int BUCKET_SIZE = 1 << BUCKET_BIT_SIZE;
+	static const int NUM_WORK_BIN = 64;
+	static const IndexType NOT_FOUND = static_cast<IndexType>(-1);
+
+private:
+	boost::atomic<IndexType> m_count;
+	boost::atomic<IndexType> m_nInsertSinceCollect;
+	boost::atomic<unsigned long long> m_nStore;
+	boost::atomic<bool> m_bCollecting;
+	const IndexType m_bucketMask;
+	const size_t m_size;
+	SpinLock* m_bucketLock;
+
+public:
+	_data* m_entry;
+
+	BucketHashTable(int bitSize = 12)
+		: m_count(0)
+		, m_nInsertSinceCollect(0)
+		, m_nStore(0)
+		, m_bCollecting(false)
+		, m_bucketMask((1 << (bitSize - BUCKET_BIT_SIZE)) - 1)
+		, m_size(1ULL << bitSize)
+		, m_bucketLock(new SpinLock[1ULL << (bitSize - BUCKET_BIT_SIZE)])
+		, m_entry(new _data[1ULL << bitSize])
+	{}
+
+	~BucketHashTable()
+	{
+		delete[] m_entry;
+		delete[] m_bucketLock;
+	}
+
+	inline IndexType getCount() const { return m_count.load(boost::memory_order_relaxed); }
+	inline IndexType getNumInsertSinceCollect() const { return m_nInsertSinceCollect.load(boost::memory_order_relaxed); }
+	inline unsigned long long getNumStore() const { return m_nStore.load(boost::memory_order_relaxed); }
+	inline void countStore() { m_nStore++; }
+	inline size_t getSize() const { return m_size; }
+
+	IndexType lookup(const HashKey& key)
+	{
+		IndexType bucket = static_cast<IndexType>(key)&m_bucketMask;
+		m_bucketLock[bucket].lock();
+		IndexType index = find(bucket, key);
+		m_bucketLock[bucket].unlock();
+
+		return index;
+	}
+
+	// if key is already in table, data is not written and bInserted is false
+	// return -1 if all entries of the bucket can not be replaced
+	// speculative stores pass bCount = false, and call countStore when the entry is really used
+	IndexType store(const HashKey& key, const _data& data, bool& bInserted, bool bCount = true)
+	{
+		bInserted = false;
+		IndexType bucket = static_cast<IndexType>(key)&m_bucketMask;
+		m_bucketLock[bucket].lock();
+
+		IndexType index = find(bucket, key);
+		if (index == NOT_FOUND) {
+			// find a free entry, or the replaceable entry with the least work
+			IndexType begin = bucket << BUCKET_BIT_SIZE;
+			for (IndexType i = begin; i < begin + BUCKET_SIZE; ++i) {
+				const _data& entry = m_entry[i];
+				if (entry.isFree()) { index = i; break; }
+				if (!entry.isReplaceable()) { continue; }
+				if (index == NOT_FOUND || entry.getWork() < m_entry[index].getWork()) { index = i; }
+			}
+
+			if (index != NOT_FOUND) {
+				_data& entry = m_entry[index];
+				if (entry.isFree()) { m_count++; }
+				entry = data;
+				entry.setKey(key);
+				m_nInsertSinceCollect++;
+				if (bCount) { m_nStore++; }
+				bInserted = true;
+			}
+		}
+
+		m_bucketLock[bucket].unlock();
+		return index;
+	}
+
+	inline void lock(IndexType index) { m_bucketLock[index >> BUCKET_BIT_SIZE].lock(); }
+	inline void unlock(IndexType index) { m_bucketLock[index >> BUCKET_BIT_SIZE].unlock(); }
+
+	// lock and check the entry still holds key (it may be replaced after lookup)
+	inline bool lock(IndexType index, const HashKey& key)
+	{
+		lock(index);
+		if (m_entry[index].hasKey(key)) { return true; }
+		unlock(index);
+		return false;
+	}
+
+	/*!
+		@brief  SmallTreeGC, remove about removeRatio of entries which have small work
+		@return number of removed entries (0 if other thread is collecting)
+	*/
+	IndexType collect(float removeRatio)
+	{
+		if (m_bCollecting.exchange(true, boost::memory_order_acquire)) { return 0; }
+		m_nInsertSinceCollect = 0;
+
+		// histogram of log2(work)
+		IndexType vNumWork[NUM_WORK_BIN] = { 0 };
+		for (IndexType bucket = 0; bucket <= m_bucketMask; ++bucket) {
+			m_bucketLock[bucket].lock();
+			for (IndexType i = (bucket << BUCKET_BIT_SIZE); i < ((bucket + 1) << BUCKET_BIT_SIZE); ++i) {
+				if (m_entry[i].isFree()) { continue; }
+				++vNumWork[getWorkBin(m_entry[i].getWork())];
+			}
+			m_bucketLock[bucket].unlock();
+		}
+
+		int threshold = 0;
+		IndexType nRemove = 0;
+		const IndexType nTarget = static_cast<IndexType>(getCount() * removeRatio);
+		while (threshold < NUM_WORK_BIN && nRemove < nTarget) { nRemove += vNumWork[threshold++]; }
+
+		nRemove = 0;
+		for (IndexType bucket = 0; bucket <= m_bucketMask; ++bucket) {
+			m_bucketLock[bucket].lock();
+			for (IndexType i = (bucket << BUCKET_BIT_SIZE); i < ((bucket + 1) << BUCKET_BIT_SIZE); ++i) {
+				_data& entry = m_entry[i];
+				if (entry.isFree() || !entry.isReplaceable()) { continue; }
+				if (getWorkBin(entry.getWork()) >= threshold) { continue; }
+				entry.clear();
+				m_count--;
+				++nRemove;
+			}
+			m_bucketLock[bucket].unlock();
+		}
+
+		m_bCollecting.store(false, boost::memory_order_release);
+		return nRemove;
+	}
+
+	void clear()
+	{
+		m_count = 0;
+		m_nInsertSinceCollect = 0;
+		m_nStore = 0;
+		for (IndexType i = 0; i < m_size; ++i) { m_entry[i].clear(); }
+	}
+
+private:
+	inline IndexType find(IndexType bucket, const HashKey& key) const
+	{
+		IndexType begin = bucket << BUCKET_BIT_SIZE;
+		for (IndexType i = begin; i < begin + BUCKET_SIZE; ++i) {
+			if (m_entry[i].hasKey(key)) { return i; }
+		}
+		return NOT_FOUND;
+	}
+
+	inline int getWorkBin(unsigned long long work) const
+	{
+		int bin = 0;
+		while (work > 1 && bin < NUM_WORK_BIN - 1) { work >>= 1; ++bin; }
+		return bin;
+	}
+};
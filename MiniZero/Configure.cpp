@@ -22,6 +22,10 @@ namespace Configure {
 	int NET_ROTATION = 1;
 	bool NET_VALUE_WINLOSS = true;
 	bool NET_VALUE_SPACE_COMPLEXITY = false;
+	string NET_DEVICE = "cuda";
+	int NET_CPU_NUM_THREAD = 0;
+	string NET_PRECISION = "fp32";
+	bool NET_OPTIMIZE_FOR_INFERENCE = false;
 	bool USE_TRANSPOSITION_TABLE = false;
 
 	// MCTS parameters
@@ -30,6 +34,8 @@ namespace Configure {
 	bool MCTS_USE_NOISE_AT_ROOT = false;
 	bool MCTS_SELECT_BY_COUNT_PROPORTION = false;
 	int MCTS_SIMULATION_COUNT = 400;
+	int MCTS_VIRTUAL_LOSS = 1;
+	bool MCTS_REUSE_TREE = false;
 
 	// PNS parameters
 	int PNS_NUM_EXPANSION = 400;
@@ -40,6 +46,10 @@ namespace Configure {
 	bool PNS_ENABLE_1_PLUS_EPSILON = false;
 	float PNS_EPSILON_VALUE = 0.25f;
 	bool PNS_ENABLE_WEAK_PNS = false;
+	int PNS_TT_BIT_SIZE = 28;
+	float PNS_TT_GC_LOAD_RATIO = 0.9f;
+	float PNS_TT_GC_REMOVE_RATIO = 0.3f;
+	int PNS_TT_CANDIDATE_PER_ENTRY = 4;
 
 	// zero training parameters
 	int ZERO_SERVER_PORT = 9999;
@@ -50,6 +60,8 @@ namespace Configure {
 	int ZERO_NUM_GAME = 5000;
 	float ZERO_NOISE_EPSILON = 0.25f;
 	float ZERO_NOISE_ALPHA = 0.2f;
+	int ZERO_UPLOAD_BATCH_SIZE = 16;
+	int ZERO_MAX_PENDING_GAMES = 256;
 
 	// AOT training parameters
 	int AOT_BRANCHING_FACTOR = 0;
@@ -75,6 +87,10 @@ namespace Configure {
 		cl.addParameter(GET_VAR_NAME(NET_ROTATION), NET_ROTATION, "0: no rotation, 1-8: average of random # rotation", "Network");
 		cl.addParameter(GET_VAR_NAME(NET_VALUE_WINLOSS), NET_VALUE_WINLOSS, "", "Network");
 		cl.addParameter(GET_VAR_NAME(NET_VALUE_SPACE_COMPLEXITY), NET_VALUE_SPACE_COMPLEXITY, "", "Network");
+		cl.addParameter(GET_VAR_NAME(NET_DEVICE), NET_DEVICE, "cuda: run on the GPUs in GPU_LIST, cpu: run on CPU", "Network");
+		cl.addParameter(GET_VAR_NAME(NET_CPU_NUM_THREAD), NET_CPU_NUM_THREAD, "Number of intra-op threads for CPU inference (0: default of libtorch)", "Network");
+		cl.addParameter(GET_VAR_NAME(NET_PRECISION), NET_PRECISION, "fp32, bf16 (cpu only), int8 (cpu only, MODEL_FILE should be exported by py/Quantize.py)", "Network");
+		cl.addParameter(GET_VAR_NAME(NET_OPTIMIZE_FOR_INFERENCE), NET_OPTIMIZE_FOR_INFERENCE, "Freeze the model and fuse conv/bn (use oneDNN kernels on cpu)", "Network");
 		cl.addParameter(GET_VAR_NAME(USE_TRANSPOSITION_TABLE), USE_TRANSPOSITION_TABLE, "", "Network");
 
 		// MCTS parameters
@@ -83,6 +99,8 @@ namespace Configure {
 		cl.addParameter(GET_VAR_NAME(MCTS_USE_NOISE_AT_ROOT), MCTS_USE_NOISE_AT_ROOT, "", "MCTS");
 		cl.addParameter(GET_VAR_NAME(MCTS_SELECT_BY_COUNT_PROPORTION), MCTS_SELECT_BY_COUNT_PROPORTION, "", "MCTS");
 		cl.addParameter(GET_VAR_NAME(MCTS_SIMULATION_COUNT), MCTS_SIMULATION_COUNT, "", "MCTS");
+		cl.addParameter(GET_VAR_NAME(MCTS_VIRTUAL_LOSS), MCTS_VIRTUAL_LOSS, "Number of virtual losses added to each selected node when NUM_THREAD > 1", "MCTS");
+		cl.addParameter(GET_VAR_NAME(MCTS_REUSE_TREE), MCTS_REUSE_TREE, "Reuse the subtree of the played move (only for NET_VALUE_WINLOSS), visit counts then include simulations of the previous search", "MCTS");
 
 		// PNS parameters
 		cl.addParameter(GET_VAR_NAME(PNS_NUM_EXPANSION), PNS_NUM_EXPANSION, "The number of maximum expanded nodes", "PNS");
@@ -93,6 +111,10 @@ namespace Configure {
 		cl.addParameter(GET_VAR_NAME(PNS_ENABLE_1_PLUS_EPSILON), PNS_ENABLE_1_PLUS_EPSILON, "Enable 1+epsilon", "PNS");
 		cl.addParameter(GET_VAR_NAME(PNS_EPSILON_VALUE), PNS_EPSILON_VALUE, "Set epsilon value in 1+epsilon method", "PNS");
 		cl.addParameter(GET_VAR_NAME(PNS_ENABLE_WEAK_PNS), PNS_ENABLE_WEAK_PNS, "Enable weak PN/DN computation in PNS", "PNS");
+		cl.addParameter(GET_VAR_NAME(PNS_TT_BIT_SIZE), PNS_TT_BIT_SIZE, "The number of DFPN TT entries is 2^PNS_TT_BIT_SIZE", "PNS");
+		cl.addParameter(GET_VAR_NAME(PNS_TT_GC_LOAD_RATIO), PNS_TT_GC_LOAD_RATIO, "Run garbage collection when the ratio of used TT entries reaches it", "PNS");
+		cl.addParameter(GET_VAR_NAME(PNS_TT_GC_REMOVE_RATIO), PNS_TT_GC_REMOVE_RATIO, "The ratio of TT entries (with small subtree) removed by garbage collection", "PNS");
+		cl.addParameter(GET_VAR_NAME(PNS_TT_CANDIDATE_PER_ENTRY), PNS_TT_CANDIDATE_PER_ENTRY, "The number of candidate moves kept for DFPN TT is PNS_TT_CANDIDATE_PER_ENTRY times of TT entries (rounded up to power of 2), none for vanilla PNS", "PNS");
 
 		// zero training parameters
 		cl.addParameter(GET_VAR_NAME(ZERO_SERVER_PORT), ZERO_SERVER_PORT, "", "Zero Training");
@@ -103,6 +125,8 @@ namespace Configure {
 		cl.addParameter(GET_VAR_NAME(ZERO_NUM_GAME), ZERO_NUM_GAME, "Number of games for each iteration", "Zero Training");
 		cl.addParameter(GET_VAR_NAME(ZERO_NOISE_EPSILON), ZERO_NOISE_EPSILON, "", "Zero Training");
 		cl.addParameter(GET_VAR_NAME(ZERO_NOISE_ALPHA), ZERO_NOISE_ALPHA, "", "Zero Training");
+		cl.addParameter(GET_VAR_NAME(ZERO_UPLOAD_BATCH_SIZE), ZERO_UPLOAD_BATCH_SIZE, "Number of self-play games sent to server in one message", "Zero Training");
+		cl.addParameter(GET_VAR_NAME(ZERO_MAX_PENDING_GAMES), ZERO_MAX_PENDING_GAMES, "Worker waits when this many games are not sent, server stops reading when this many games are queued", "Zero Training");
 
 		// AOT training parameters
 		cl.addParameter(GET_VAR_NAME(AOT_BRANCHING_FACTOR), AOT_BRANCHING_FACTOR, "0: maximum actions, 1: legal actions, 2: actions with domain knowledge", "AOT Training");
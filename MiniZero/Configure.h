@@ -22,6 +22,10 @@ namespace Configure {
 	extern int NET_ROTATION;
 	extern bool NET_VALUE_WINLOSS;
 	extern bool NET_VALUE_SPACE_COMPLEXITY;
+	extern string NET_DEVICE;
+	extern int NET_CPU_NUM_THREAD;
+	extern string NET_PRECISION;
+	extern bool NET_OPTIMIZE_FOR_INFERENCE;
 	extern bool USE_TRANSPOSITION_TABLE;
 
 	// MCTS parameters
@@ -30,6 +34,8 @@ namespace Configure {
 	extern bool MCTS_USE_NOISE_AT_ROOT;
 	extern bool MCTS_SELECT_BY_COUNT_PROPORTION;
 	extern int MCTS_SIMULATION_COUNT;
+	extern int MCTS_VIRTUAL_LOSS;
+	extern bool MCTS_REUSE_TREE;
 
 	// PNS parameters
 	extern int PNS_NUM_EXPANSION;
@@ -40,6 +46,10 @@ namespace Configure {
 	extern bool PNS_ENABLE_1_PLUS_EPSILON;
 	extern float PNS_EPSILON_VALUE;
 	extern bool PNS_ENABLE_WEAK_PNS;
+	extern int PNS_TT_BIT_SIZE;
+	extern float PNS_TT_GC_LOAD_RATIO;
+	extern float PNS_TT_GC_REMOVE_RATIO;
+	extern int PNS_TT_CANDIDATE_PER_ENTRY;
 
 	// zero training parameters
 	extern int ZERO_SERVER_PORT;
@@ -50,6 +60,8 @@ namespace Configure {
 	extern int ZERO_NUM_GAME;
 	extern float ZERO_NOISE_EPSILON;
 	extern float ZERO_NOISE_ALPHA;
+	extern int ZERO_UPLOAD_BATCH_SIZE;
+	extern int ZERO_MAX_PENDING_GAMES;
 
 	// AOT training parameters
 	extern int AOT_BRANCHING_FACTOR;
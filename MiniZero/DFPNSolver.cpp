@@ -1,35 +1,48 @@
 #include "DFPNSolver.h"
 #include "SgfLoader.h"
 
-void DFPNSolver::solve()
+void DFPNSolverSlave::reset()
 {
-	std::srand(Configure::SEED);
+	// each thread replays the problem on its own game
+	m_game.reset();
+	const vector<Move>& vMoves = m_sharedData.m_pGame->getMoves();
+	for (size_t i = 0; i < vMoves.size(); ++i) { m_game.play(vMoves[i]); }
+	if (Configure::USE_NET && m_network->getModelName() != m_sharedData.m_pNetwork->getModelName()) {
+		m_network->loadModel(m_sharedData.m_pNetwork->getModelName());
+	}
+
+	m_nMID = 0;
+	m_nExpansion = 0;
+	m_nForward = 0;
+	m_root.reset(Move(AgainstColor(m_game.getTurnColor()), -1));
+	m_root.setHashkey(m_game.getTTHashKey());
 	m_timer.reset();
 	m_timer.start();
-	newTree();
-	TreeNode* pRoot = getRootNode();
-	Move lastMove = m_game.getMoves().back();
-	pRoot->setHashkey(m_game.getTTHashKey());
-	MID(pRoot, DBL_MAX, DBL_MAX);
-	m_game.play(lastMove);
 
 	return;
 }
 
-void DFPNSolver::newTree()
+void DFPNSolverSlave::doSlaveJob()
 {
-	m_set.clear();
-	m_nExpansion = 0;
-	m_nMID = 0;
-	m_nodeUsedIndex = 1;
-	m_vSelectNodePath.clear();
-	getRootNode()->reset(Move(AgainstColor(m_game.getTurnColor()), -1));
-	m_transpositionTable.clear();
+	MID(getRootNode(), DBL_MAX, DBL_MAX);
+	m_sharedData.m_bStop = true;
 
 	return;
 }
 
-void DFPNSolver::evaluate(TreeNode* pNode)
+void DFPNSolverSlave::initialize()
+{
+	BaseSlave::initialize();
+
+	// the first thread shares the network of solver, others load their own
+	if (m_id == 0) { m_network = m_sharedData.m_pNetwork; }
+	else {
+		m_network = new Network(Configure::GPU_LIST[m_id % Configure::GPU_LIST.length()] - '0', Configure::MODEL_FILE);
+		if (Configure::USE_NET) { m_network->initialize(); }
+	}
+}
+
+void DFPNSolverSlave::evaluate(TreeNode* pNode)
 {
 	if (m_game.isTerminal()) {
 		Color winner = m_game.eval();
@@ -40,7 +53,7 @@ void DFPNSolver::evaluate(TreeNode* pNode)
 	return;
 }
 
-void DFPNSolver::setTerminalValue(TreeNode* pMPN)
+void DFPNSolverSlave::setTerminalValue(TreeNode* pMPN)
 {
 	Color winner = m_game.eval();
 	float value = 0.0f;
@@ -56,7 +69,7 @@ void DFPNSolver::setTerminalValue(TreeNode* pMPN)
 	return;
 }
 
-void DFPNSolver::updateSolutionStatus(TreeNode* pNode)
+void DFPNSolverSlave::updateSolutionStatus(TreeNode* pNode)
 {
 	if (!pNode->hasChildren()) { return; }
 
@@ -71,7 +84,7 @@ void DFPNSolver::updateSolutionStatus(TreeNode* pNode)
 	return;
 }
 
-void DFPNSolver::updatePNDN(TreeNode* pNode, double initPN, double initDN)
+void DFPNSolverSlave::updatePNDN(TreeNode* pNode, double initPN, double initDN)
 {
 	if (pNode->getSolutionStatus() == SOLUTION_WIN) { pNode->setProofNumber(DBL_MAX); pNode->setDisproofNumber(0); return; }
 	else if (pNode->getSolutionStatus() == SOLUTION_LOSS) { pNode->setProofNumber(0); pNode->setDisproofNumber(DBL_MAX); return; }
@@ -105,18 +118,19 @@ void DFPNSolver::updatePNDN(TreeNode* pNode, double initPN, double initDN)
 	return;
 }
 
-void DFPNSolver::MID(TreeNode* pNode, double PNthreshold, double DNthreshold)
+void DFPNSolverSlave::MID(TreeNode* pNode, double PNthreshold, double DNthreshold)
 {
-	++m_nMID;
+	ull startMID = m_nMID++;
 	evaluate(pNode);
 	if (m_game.isTerminal()) {
 		setTerminalValue(pNode);
 		updateSolutionStatus(pNode);
 		updatePNDN(pNode);
 		DFPNTTEntry entry;
-		entry.m_dProofNumber = pNode->getProofNumber();
-		entry.m_dDisproofNumber = pNode->getDisproofNumber();
-		entry.m_solutionStatus = pNode->getSolutionStatus();
+		entry.setProofNumber(pNode->getProofNumber());
+		entry.setDisproofNumber(pNode->getDisproofNumber());
+		entry.setSolutionStatus(pNode->getSolutionStatus());
+		entry.addWork(1);
 		storeTTEntry(pNode->getHashkey(), entry);
 		//if (m_transpositionTable.getCount() % 10000 == 0) { cerr << m_transpositionTable.getCount() << endl; }
 		m_game.undo();
@@ -125,39 +139,26 @@ void DFPNSolver::MID(TreeNode* pNode, double PNthreshold, double DNthreshold)
 
 	// Expand node
 	vector<TreeNode> vChildren;
-	vector<pair<Move, float>> vCandidate;
+	ull candidateOffset = 0;
+	int nCandidate = 0;
 	float proofValue = 0.0f;
 	float disproofValue = 0.0f;
 
+	++m_nExpansion;
 	if (Configure::PNS_MODE == VANILLA_PNS) { expandVanillaNode(pNode, vChildren); } 
-	else { expandCNNNode(pNode, vCandidate, vChildren, proofValue, disproofValue); }
+	else { expandCNNNode(pNode, vChildren, candidateOffset, nCandidate, proofValue, disproofValue); }
+
+	// mark this node as being searched, other threads will prefer its siblings
+	vector<int> vVirtualVisit;
+	if (isParallel()) { updateTTEntry(pNode, candidateOffset, nCandidate, proofValue, disproofValue, 0, 1); }
 
 	// MID MPN
 	while (1) {
+		if (isParallel()) { updateChildrenFromTT(pNode, vVirtualVisit); }
 		updateSolutionStatus(pNode);
 		updatePNDN(pNode);
 		if (pNode->getProofNumber() >= PNthreshold || pNode->getDisproofNumber() >= DNthreshold || isExpansionEnd()) {
-			// 1. First meet, store value and policy
-			// 2. Not first, only update PN and DN to TT.
-			int index = getTTEntryIndex(pNode->getHashkey());
-			if (index == -1) {
-				// new and store
-				DFPNTTEntry entry;
-				entry.m_fProofValue = proofValue;
-				entry.m_fDisproofValue = disproofValue;
-				entry.m_dProofNumber = pNode->getProofNumber();
-				entry.m_dDisproofNumber = pNode->getDisproofNumber();
-				entry.m_solutionStatus = pNode->getSolutionStatus();
-				entry.m_vCandidate = vCandidate;
-				storeTTEntry(pNode->getHashkey(), entry);
-				//if (m_transpositionTable.getCount() % 10000 == 0) { cerr << m_transpositionTable.getCount() << endl; }
-			} else {
-				// update
-				DFPNTTEntry& entry = getTTEntry(index);
-				entry.m_dProofNumber = pNode->getProofNumber();
-				entry.m_dDisproofNumber = pNode->getDisproofNumber();
-				entry.m_solutionStatus = pNode->getSolutionStatus();
-			}
+			updateTTEntry(pNode, candidateOffset, nCandidate, proofValue, disproofValue, m_nMID - startMID, isParallel() ? -1 : 0);
 			m_game.undo();
 			pNode->setNumChild(0);
 			return;
@@ -166,10 +167,11 @@ void DFPNSolver::MID(TreeNode* pNode, double PNthreshold, double DNthreshold)
 		double dMinDN = DBL_MAX;
 		double d2ndMinDN = DBL_MAX;
 		double dPnOfMinDNChild = 0.0f;
-		TreeNode* pMPN = selectBestChild(pNode, dPnOfMinDNChild, dMinDN, d2ndMinDN);
+		TreeNode* pMPN = selectBestChild(pNode, dPnOfMinDNChild, dMinDN, d2ndMinDN, vVirtualVisit);
 		// If found win in TT, not MID.
 		if (pMPN->getSolutionStatus() == SOLUTION_WIN) { continue; }
 
+		if (Configure::PNS_MODE != VANILLA_PNS && Configure::NET_BATCH_SIZE > 1) { evaluateInBatch(pNode, pMPN); }
 		m_game.play(pMPN->getMove());
 		double dThresChangeTo2nd = Configure::PNS_ENABLE_1_PLUS_EPSILON ? ceil(d2ndMinDN*(1.00f + Configure::PNS_EPSILON_VALUE)) : (d2ndMinDN + 1.00f);
 		double dNextPNThreshold = (DNthreshold == DBL_MAX) ? DNthreshold : DNthreshold - pNode->getDisproofNumber() + dPnOfMinDNChild;
@@ -180,7 +182,27 @@ void DFPNSolver::MID(TreeNode* pNode, double PNthreshold, double DNthreshold)
 	return;
 }
 
-void DFPNSolver::expandVanillaNode(TreeNode* pNode, vector<TreeNode>& vChildren)
+void DFPNSolverSlave::updateChildrenFromTT(TreeNode* pNode, vector<int>& vVirtualVisit)
+{
+	// other threads may have changed PN and DN of children
+	vVirtualVisit.assign(pNode->getNumChild(), 0);
+	TreeNode* pChild = pNode->getFirstChild();
+	for (int i = 0; i < pNode->getNumChild(); ++i, ++pChild) {
+		int index = getTTEntryIndex(pChild->getHashkey());
+		if (index == -1 || !m_sharedData.m_transpositionTable.lock(index, pChild->getHashkey())) { continue; }
+
+		DFPNTTEntry& entry = getTTEntry(index);
+		pChild->setSolutionStatus(entry.getSolutionStatus());
+		pChild->setProofNumber(entry.getProofNumber());
+		pChild->setDisproofNumber(entry.getDisproofNumber());
+		vVirtualVisit[i] = entry.m_nVirtualVisit;
+		m_sharedData.m_transpositionTable.unlock(index);
+	}
+
+	return;
+}
+
+void DFPNSolverSlave::expandVanillaNode(TreeNode* pNode, vector<TreeNode>& vChildren)
 {
 	Color turnColor = m_game.getTurnColor();
 	vector<Move> vCandidate;
@@ -201,43 +223,55 @@ void DFPNSolver::expandVanillaNode(TreeNode* pNode, vector<TreeNode>& vChildren)
 		m_game.play(pChild->getMove());
 		pChild->setHashkey(m_game.getTTHashKey());
 		m_game.undo();
-		if (findEntryInTT(pChild->getHashkey())) { getPNDNfromTT(pChild); }
-		else { updatePNDN(pChild); }
+		if (!getPNDNfromTT(pChild)) { updatePNDN(pChild); }
 	}
 
 	return;
 }
 
-void DFPNSolver::expandCNNNode(TreeNode* pNode, vector<pair<Move, float>>& vCandidate, vector<TreeNode>& vChildren, float& proofValue, float& disproofValue)
+void DFPNSolverSlave::expandCNNNode(TreeNode* pNode, vector<TreeNode>& vChildren, ull& candidateOffset, int& nCandidate, float& proofValue, float& disproofValue)
 {
-	// expand
-	int index = getTTEntryIndex(pNode->getHashkey());
-	if (index != -1) {
-		vCandidate = getTTEntry(index).m_vCandidate;
-	} else {
+	// expand, candidates in TT may be overwritten by newer ones
+	DFPNTTEntry ttEntry;
+	bool bFoundInTT = getTTEntry(pNode->getHashkey(), ttEntry) && ttEntry.m_nCandidate > 0;
+	if (bFoundInTT) {
+		candidateOffset = ttEntry.getCandidateOffset();
+		nCandidate = ttEntry.m_nCandidate;
+		vChildren.resize(nCandidate);
+		bFoundInTT = m_sharedData.m_candidateSlab.load(candidateOffset, nCandidate, m_game.getTurnColor(), &vChildren[0]);
+	}
+	if (!bFoundInTT) {
 		m_network->set_data(0, m_game);
 		m_network->forward();
-		vCandidate = m_network->getProbability(0);
+		++m_nForward;
+		vector<pair<Move, float>> vCandidate = m_network->getProbability(0);
+		candidateOffset = m_sharedData.m_candidateSlab.store(vCandidate);
+		nCandidate = vCandidate.size();
+		vChildren.resize(nCandidate);
+		for (int iCandidate = 0; iCandidate < nCandidate; ++iCandidate) {
+			vChildren[iCandidate].reset(vCandidate[iCandidate].first);
+			vChildren[iCandidate].setProbability(vCandidate[iCandidate].second);
+		}
 	}
-	vChildren.resize(vCandidate.size());
-	pNode->setNumChild(vCandidate.size());
+	pNode->setNumChild(nCandidate);
 	pNode->setFirstChild(&vChildren[0]);
 
 	// value network
 	if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
 		Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
 		Color proofColor = (Configure::AOT_PROOF_COLOR == COLOR_NONE) ? rootTurn : Configure::AOT_PROOF_COLOR;
-		if (index != -1) {
-			proofValue = getTTEntry(index).m_fProofValue;
-			disproofValue = getTTEntry(index).m_fDisproofValue;
+		if (bFoundInTT) {
+			proofValue = ttEntry.getProofValue();
+			disproofValue = ttEntry.getDisproofValue();
 		} else {
 			proofValue = m_network->getValue(0, proofColor);
 			disproofValue = m_network->getValue(0, AgainstColor(proofColor));
 		}
 	} else {
-		if (index != -1) {
-			float value = getTTEntry(index).m_fProofValue;
-			pNode->setValue(value);
+		if (bFoundInTT) {
+			float value = ttEntry.getProofValue();
+			proofValue = value;
+			pNode->setValue(-1.0f*value);
 		} else {
 			float value = m_network->getValue(0);
 			proofValue = value;
@@ -246,20 +280,17 @@ void DFPNSolver::expandCNNNode(TreeNode* pNode, vector<pair<Move, float>>& vCand
 	}
 
 	TreeNode* pChild = pNode->getFirstChild();
-	for (int iCandidate = 0; iCandidate < vCandidate.size(); ++iCandidate, ++pChild) {
-		pChild->reset(vCandidate[iCandidate].first);
-		pChild->setProbability(vCandidate[iCandidate].second);
+	for (int iCandidate = 0; iCandidate < nCandidate; ++iCandidate, ++pChild) {
 		assert(m_game.isLegalMove(pChild->getMove()));
 		m_game.play(pChild->getMove());
 		pChild->setHashkey(m_game.getTTHashKey());
 		m_game.undo();
-		if (findEntryInTT(pChild->getHashkey())) { getPNDNfromTT(pChild);}
-		else {
+		if (!getPNDNfromTT(pChild)) {
 			if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
 				Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
 				Color proofColor = (Configure::AOT_PROOF_COLOR == COLOR_NONE) ? rootTurn : Configure::AOT_PROOF_COLOR;
-				if (pChild->getMove().getColor() == proofColor) { updatePNDN(pChild, disproofValue / (float)vCandidate.size(), proofValue); }
-				else if (pChild->getMove().getColor() == AgainstColor(proofColor)) { updatePNDN(pChild, proofValue / (float)vCandidate.size(), disproofValue); }
+				if (pChild->getMove().getColor() == proofColor) { updatePNDN(pChild, disproofValue / (float)nCandidate, proofValue); }
+				else if (pChild->getMove().getColor() == AgainstColor(proofColor)) { updatePNDN(pChild, proofValue / (float)nCandidate, disproofValue); }
 			} else { updatePNDN(pChild); }
 		}
 	}
@@ -267,7 +298,70 @@ void DFPNSolver::expandCNNNode(TreeNode* pNode, vector<pair<Move, float>>& vCand
 	return;
 }
 
-TreeNode* DFPNSolver::selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild, double& dMinDN, double& d2ndMinDN)
+void DFPNSolverSlave::evaluateInBatch(TreeNode* pNode, TreeNode* pMPN)
+{
+	// MPN is evaluated in one forward with the siblings which are likely selected next,
+	// so that MID expands all of them with the candidates kept in TT
+	if (static_cast<int>(getTTEntryIndex(pMPN->getHashkey())) != -1) { return; }
+
+	m_game.play(pMPN->getMove());
+	bool bTerminal = m_game.isTerminal();
+	if (!bTerminal) { m_network->set_data(0, m_game); }
+	m_game.undo();
+	if (bTerminal) { return; }
+
+	vector<TreeNode*> vSiblings;
+	int numLiveChildren = 0;
+	int limitSize = getNumLimitSize(pNode);
+	TreeNode* pChild = pNode->getFirstChild();
+	for (int i = 0; i < pNode->getNumChild() && numLiveChildren < limitSize; ++i, ++pChild) {
+		if (pChild->getSolutionStatus() != SOLUTION_UNKNOWN) { continue; }
+		++numLiveChildren;
+		if (pChild == pMPN || static_cast<int>(getTTEntryIndex(pChild->getHashkey())) != -1) { continue; }
+		vSiblings.push_back(pChild);
+	}
+	// the child with the smallest DN is selected first
+	stable_sort(vSiblings.begin(), vSiblings.end(), [](const TreeNode* lhs, const TreeNode* rhs) {
+		return lhs->getDisproofNumber() < rhs->getDisproofNumber();
+	});
+
+	vector<TreeNode*> vEvaluateChildren(1, pMPN);
+	for (size_t i = 0; i < vSiblings.size() && vEvaluateChildren.size() < static_cast<size_t>(Configure::NET_BATCH_SIZE); ++i) {
+		m_game.play(vSiblings[i]->getMove());
+		if (!m_game.isTerminal()) {
+			m_network->set_data(vEvaluateChildren.size(), m_game);
+			vEvaluateChildren.push_back(vSiblings[i]);
+		}
+		m_game.undo();
+	}
+
+	m_network->forward();
+	++m_nForward;
+	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
+	Color proofColor = (Configure::AOT_PROOF_COLOR == COLOR_NONE) ? rootTurn : Configure::AOT_PROOF_COLOR;
+	for (size_t batchID = 0; batchID < vEvaluateChildren.size(); ++batchID) {
+		pChild = vEvaluateChildren[batchID];
+		vector<pair<Move, float>> vCandidate = m_network->getProbability(batchID);
+		DFPNTTEntry entry;
+		entry.setCandidateOffset(m_sharedData.m_candidateSlab.store(vCandidate));
+		entry.m_nCandidate = vCandidate.size();
+		if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
+			entry.setProofValue(m_network->getValue(batchID, proofColor));
+			entry.setDisproofValue(m_network->getValue(batchID, AgainstColor(proofColor)));
+		} else {
+			entry.setProofValue(m_network->getValue(batchID));
+		}
+		entry.setProofNumber(pChild->getProofNumber());
+		entry.setDisproofNumber(pChild->getDisproofNumber());
+		entry.setSolutionStatus(pChild->getSolutionStatus());
+		entry.setPrefetched(true);
+		storeTTEntry(pChild->getHashkey(), entry, 0, false);
+	}
+
+	return;
+}
+
+TreeNode* DFPNSolverSlave::selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild, double& dMinDN, double& d2ndMinDN, const vector<int>& vVirtualVisit)
 {
 	TreeNode* pChild = pNode->getFirstChild();
 	// if win node if found, just return it.
@@ -282,7 +376,7 @@ TreeNode* DFPNSolver::selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild,
 	for (int i = 0; i < pNode->getNumChild(); ++i, ++pChild) {
 		if (pChild->getSolutionStatus() != SOLUTION_UNKNOWN) { continue; }
 
-		double dn = pChild->getDisproofNumber();
+		double dn = vVirtualVisit.empty() ? pChild->getDisproofNumber() : getVirtualDisproofNumber(pChild->getDisproofNumber(), vVirtualVisit[i]);
 		if (dn < dMinDN) {
 			d2ndMinDN = dMinDN;
 			dMinDN = dn;
@@ -297,7 +391,7 @@ TreeNode* DFPNSolver::selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild,
 	return pMPN;
 }
 
-int DFPNSolver::getNumLimitSize(TreeNode* pNode)
+int DFPNSolverSlave::getNumLimitSize(TreeNode* pNode)
 {
 	if (Configure::PNS_MODE != FOCUSED_PNS) { return pNode->getNumChild(); }
 
@@ -312,39 +406,195 @@ int DFPNSolver::getNumLimitSize(TreeNode* pNode)
 	return Configure::PNS_FOCUSED_CHILDREN_BASE + ceil(ratio * (float)(numLiveChildren));
 }
 
-float DFPNSolver::getAdjustedValue(TreeNode* pNode)
+float DFPNSolverSlave::getAdjustedValue(TreeNode* pNode)
 {
 	float fAdjustedValue = (-1.0f)*pNode->getValue();
 	return fmin(fmax(fAdjustedValue, -1), 1);
 }
 
-void DFPNSolver::storeTTEntry(HashKey hashkey, DFPNTTEntry& entry)
+void DFPNSolverSlave::storeTTEntry(HashKey hashkey, DFPNTTEntry& entry, int virtualVisit, bool bUpdateExisting)
+{
+	// after a GC, wait for as many new entries as it should remove, otherwise a GC which removes few entries
+	// (e.g. most are being searched) would run again for every store
+	BucketHashTable<DFPNTTEntry>& transpositionTable = m_sharedData.m_transpositionTable;
+	if (transpositionTable.getCount() >= transpositionTable.getSize() * Configure::PNS_TT_GC_LOAD_RATIO
+		&& transpositionTable.getNumInsertSinceCollect() >= transpositionTable.getSize() * Configure::PNS_TT_GC_REMOVE_RATIO) {
+		transpositionTable.collect(Configure::PNS_TT_GC_REMOVE_RATIO);
+	}
+
+	bool bInserted;
+	entry.m_nVirtualVisit = max(virtualVisit, 0);
+	// prefetched entries are not counted as expansions until MID expands them
+	int index = transpositionTable.store(hashkey, entry, bInserted, !entry.isPrefetched());
+	if (bInserted || index == -1 || !bUpdateExisting) { return; }
+
+	// already stored by other thread
+	updateTTEntryPNDN(index, hashkey, entry, virtualVisit);
+}
+
+bool DFPNSolverSlave::updateTTEntryPNDN(unsigned int index, HashKey hashkey, const DFPNTTEntry& entry, int virtualVisit)
 {
-	while (m_transpositionTable.isFull()) { cerr << "TT is full!" << endl; }
-	m_transpositionTable.store(hashkey, entry);
+	if (!m_sharedData.m_transpositionTable.lock(index, hashkey)) { return false; }
+
+	// never overwrite a solved entry
+	DFPNTTEntry& ttEntry = getTTEntry(index);
+	if (ttEntry.isPrefetched()) {
+		ttEntry.setPrefetched(false);
+		m_sharedData.m_transpositionTable.countStore();
+	}
+	if (ttEntry.getSolutionStatus() == SOLUTION_UNKNOWN) {
+		ttEntry.m_fProofNumber = entry.m_fProofNumber;
+		ttEntry.m_fDisproofNumber = entry.m_fDisproofNumber;
+		ttEntry.m_solutionStatus = entry.m_solutionStatus;
+	}
+	if (entry.m_nCandidate > 0) {
+		// candidates may be evaluated again after overwritten
+		ttEntry.setCandidateOffset(entry.getCandidateOffset());
+		ttEntry.m_nCandidate = entry.m_nCandidate;
+	}
+	ttEntry.addWork(entry.getWork());
+	ttEntry.addVirtualVisit(virtualVisit);
+	m_sharedData.m_transpositionTable.unlock(index);
+
+	return true;
 }
 
-DFPNTTEntry& DFPNSolver::getTTEntry(unsigned int index)
+void DFPNSolverSlave::updateTTEntry(TreeNode* pNode, ull candidateOffset, int nCandidate, float proofValue, float disproofValue, ull work, int virtualVisit)
 {
-	return m_transpositionTable.m_entry[index].m_data;
+	// 1. First meet (or replaced), store value and policy
+	// 2. Not first, only update PN and DN to TT.
+	DFPNTTEntry entry;
+	entry.setProofValue(proofValue);
+	entry.setDisproofValue(disproofValue);
+	entry.setProofNumber(pNode->getProofNumber());
+	entry.setDisproofNumber(pNode->getDisproofNumber());
+	entry.setSolutionStatus(pNode->getSolutionStatus());
+	entry.setCandidateOffset(candidateOffset);
+	entry.m_nCandidate = nCandidate;
+	entry.addWork(work);
+	int index = getTTEntryIndex(pNode->getHashkey());
+	if (index != -1 && updateTTEntryPNDN(index, pNode->getHashkey(), entry, virtualVisit)) { return; }
+
+	storeTTEntry(pNode->getHashkey(), entry, virtualVisit);
+	//if (m_transpositionTable.getCount() % 10000 == 0) { cerr << m_transpositionTable.getCount() << endl; }
+}
+
+DFPNTTEntry& DFPNSolverSlave::getTTEntry(unsigned int index)
+{
+	return m_sharedData.m_transpositionTable.m_entry[index];
 }
 
-unsigned int DFPNSolver::getTTEntryIndex(HashKey hashkey)
-{
-	return m_transpositionTable.lookup(hashkey);
-}
-
-void DFPNSolver::getPNDNfromTT(TreeNode* pNode)
-{
-	int index = getTTEntryIndex(pNode->getHashkey());
-	if (index != -1) {
-		DFPNTTEntry& entry = getTTEntry(index);
-		pNode->setSolutionStatus(entry.m_solutionStatus);
-		pNode->setProofNumber(entry.m_dProofNumber);
-		pNode->setDisproofNumber(entry.m_dDisproofNumber);
-	}
-
-	return;
+bool DFPNSolverSlave::getTTEntry(HashKey hashkey, DFPNTTEntry& entry)
+{
+	int index = getTTEntryIndex(hashkey);
+	if (index == -1 || !m_sharedData.m_transpositionTable.lock(index, hashkey)) { return false; }
+
+	entry = getTTEntry(index);
+	m_sharedData.m_transpositionTable.unlock(index);
+	return true;
+}
+
+unsigned int DFPNSolverSlave::getTTEntryIndex(HashKey hashkey)
+{
+	return m_sharedData.m_transpositionTable.lookup(hashkey);
+}
+
+bool DFPNSolverSlave::getPNDNfromTT(TreeNode* pNode)
+{
+	int index = getTTEntryIndex(pNode->getHashkey());
+	if (index == -1 || !m_sharedData.m_transpositionTable.lock(index, pNode->getHashkey())) { return false; }
+
+	DFPNTTEntry& entry = getTTEntry(index);
+	pNode->setSolutionStatus(entry.getSolutionStatus());
+	pNode->setProofNumber(entry.getProofNumber());
+	pNode->setDisproofNumber(entry.getDisproofNumber());
+	m_sharedData.m_transpositionTable.unlock(index);
+
+	return true;
+}
+
+DFPNSolver::DFPNSolver()
+	: BaseMaster(Configure::NUM_THREAD)
+{
+	assert(("Number of thread should not be 0", Configure::NUM_THREAD > 0));
+
+	if (Configure::PNS_ENABLE_DFPN) { m_nodes = new TreeNode[1]; }
+	else { m_nodes = new TreeNode[1 + Configure::PNS_NUM_EXPANSION * Game::getMaxNumLegalAction()]; }
+	m_sharedData.m_pGame = &m_game;
+	m_sharedData.m_pNetwork = m_network;
+	BaseMaster::initialize();
+}
+
+DFPNSolver::~DFPNSolver()
+{
+	// wake up all threads to let them leave
+	m_sharedData.m_bTerminate = true;
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->startRun(); }
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->finishRun(); }
+	m_threads.join_all();
+	delete[] m_nodes;
+}
+
+void DFPNSolver::solve()
+{
+	std::srand(Configure::SEED);
+	m_timer.reset();
+	m_timer.start();
+	newTree();
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->startRun(); }
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->finishRun(); }
+	summarizeSlavesData();
+
+	return;
+}
+
+void DFPNSolver::summarizeSlavesData()
+{
+	m_nMID = 0;
+	ull nExpansion = 0;
+	ull nForward = 0;
+	for (int i = 0; i < m_nThread; ++i) {
+		m_nMID += m_vSlaves[i]->getReExpansion();
+		nExpansion += m_vSlaves[i]->getNumExpansion();
+		nForward += m_vSlaves[i]->getNumForward();
+	}
+
+	// proof status of root is in TT, other threads may solve it
+	TreeNode* pRoot = getRootNode();
+	TreeNode* pSlaveRoot = m_vSlaves[0]->getRootNode();
+	pRoot->setHashkey(pSlaveRoot->getHashkey());
+	pRoot->setValue(pSlaveRoot->getValue());
+	pRoot->setSolutionStatus(pSlaveRoot->getSolutionStatus());
+	pRoot->setProofNumber(pSlaveRoot->getProofNumber());
+	pRoot->setDisproofNumber(pSlaveRoot->getDisproofNumber());
+	int index = m_sharedData.m_transpositionTable.lookup(pRoot->getHashkey());
+	if (index != -1 && m_sharedData.m_transpositionTable.lock(index, pRoot->getHashkey())) {
+		DFPNTTEntry& entry = m_sharedData.m_transpositionTable.m_entry[index];
+		pRoot->setSolutionStatus(entry.getSolutionStatus());
+		pRoot->setProofNumber(entry.getProofNumber());
+		pRoot->setDisproofNumber(entry.getDisproofNumber());
+		m_sharedData.m_transpositionTable.unlock(index);
+	}
+	// candidates overwritten in the slab are evaluated by network again
+	cerr << "expansions: " << nExpansion << ", forwards: " << nForward
+		<< ", candidate reloads: " << m_sharedData.m_candidateSlab.getNumReload() << ". ";
+
+	return;
+}
+
+void DFPNSolver::newTree()
+{
+	m_set.clear();
+	m_nExpansion = 0;
+	m_nMID = 0;
+	m_nodeUsedIndex = 1;
+	m_vSelectNodePath.clear();
+	getRootNode()->reset(Move(AgainstColor(m_game.getTurnColor()), -1));
+	m_sharedData.m_transpositionTable.clear();
+	m_sharedData.m_candidateSlab.clear();
+	m_sharedData.m_bStop = false;
+
+	return;
 }
 
 TreeNode* DFPNSolver::allocateNewNodes(int size)
@@ -381,8 +631,8 @@ string DFPNSolver::getNodeInfo(TreeNode* pNode)
 		<< "V: " << pNode->getValue() << "\r\n";
 	oss << "PN: "; if (pNode->getProofNumber() == DBL_MAX) oss << "INF"; else oss << pNode->getProofNumber(); oss << "\r\n";
 	oss << "DN: "; if (pNode->getDisproofNumber() == DBL_MAX) oss << "INF"; else oss << pNode->getDisproofNumber(); oss << "\r\n";
-	oss << "LimitSize: " << getNumLimitSize(pNode) << "\r\n";
-	oss << "Adjusted Value: " << getAdjustedValue(pNode) << "\r\n";
+	oss << "LimitSize: " << DFPNSolverSlave::getNumLimitSize(pNode) << "\r\n";
+	oss << "Adjusted Value: " << DFPNSolverSlave::getAdjustedValue(pNode) << "\r\n";
 	
 	int numLiveChildren = 0;
 	TreeNode* pChild = pNode->getFirstChild();
@@ -397,11 +647,11 @@ string DFPNSolver::getNodeInfo(TreeNode* pNode)
 std::string DFPNSolver::getTTEntryInfo(DFPNTTEntry& entry)
 {
 	ostringstream oss;
-	oss << "Status: " << getSolutionStatusString(entry.m_solutionStatus) << "\r\n"
-		<< "ProofValue: " << entry.m_fProofValue << "\r\n"
-		<< "DisproofValue: " << entry.m_fDisproofValue << "\r\n";
-	oss << "PN: "; if (entry.m_dProofNumber == DBL_MAX) oss << "INF"; else oss << entry.m_dProofNumber; oss << "\r\n";
-	oss << "DN: "; if (entry.m_dDisproofNumber == DBL_MAX) oss << "INF"; else oss << entry.m_dDisproofNumber; oss << "\r\n";
+	oss << "Status: " << getSolutionStatusString(entry.getSolutionStatus()) << "\r\n"
+		<< "ProofValue: " << entry.getProofValue() << "\r\n"
+		<< "DisproofValue: " << entry.getDisproofValue() << "\r\n";
+	oss << "PN: "; if (entry.getProofNumber() == DBL_MAX) oss << "INF"; else oss << entry.getProofNumber(); oss << "\r\n";
+	oss << "DN: "; if (entry.getDisproofNumber() == DBL_MAX) oss << "INF"; else oss << entry.getDisproofNumber(); oss << "\r\n";
 
 	return oss.str();
 }
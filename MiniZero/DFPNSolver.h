@@ -3,82 +3,259 @@
 #include "BaseSolver.h"
 #include "TreeNode.h"
 #include "Rand64.h"
-#include "OpenAddressHashTable.h"
+#include "BucketHashTable.h"
 #include <set>
+#include <cfloat>
+#include <climits>
+#include <boost/thread.hpp>
+#include "BaseMasterSlave.h"
 #include "Timer.h"
 
 #define ull unsigned long long
 
+/*!
+	@brief  compact TT entry of 32 bytes including the key check, pn/dn are saturated to 32-bit (FLT_MAX stands for DBL_MAX),
+	        values are quantized to 16-bit and candidates are kept in DFPNCandidateSlab
+*/
 class DFPNTTEntry {
+	static const unsigned char FLAG_USED = 1;
+	static const unsigned char FLAG_PREFETCHED = 2; // evaluated in batch with its siblings, but not expanded by MID yet
+
 public:
-	float m_fProofValue;
-	float m_fDisproofValue;
-	double m_dProofNumber;
-	double m_dDisproofNumber;
-	SOLUTION_STATUS m_solutionStatus;
-	vector<pair<Move, float>> m_vCandidate;
+	static const int CANDIDATE_OFFSET_BIT_SIZE = 48;
+
+	float m_fProofNumber;
+	float m_fDisproofNumber;
+	unsigned int m_nWork; // number of MID under this node, used for replacement
+	unsigned int m_keyCheck; // upper half of the hash key, the lower bits already select the bucket
+	unsigned int m_candidateOffsetLow;
+	unsigned short m_candidateOffsetHigh;
+	unsigned short m_nCandidate;
+	unsigned short m_proofValue;
+	unsigned short m_disproofValue;
+	unsigned short m_nVirtualVisit; // number of threads searching under this node
+	unsigned char m_solutionStatus;
+	unsigned char m_flag;
 
 	DFPNTTEntry() {
 		clear();
 	}
 
-	DFPNTTEntry(float proofVal, float disproofVal, double pn, double dn, SOLUTION_STATUS status, vector<pair<Move, float>> vProb) {
-		m_fProofValue = proofVal;
-		m_fDisproofValue = disproofVal;
-		m_dProofNumber = pn;
-		m_dDisproofNumber = dn;
-		m_solutionStatus = status;
-		m_vCandidate = vProb;
-	}
-
 	void clear() {
-		m_dProofNumber = m_dDisproofNumber = -1;
-		m_fProofValue = m_fDisproofValue = 0.0f;
+		m_fProofNumber = m_fDisproofNumber = -1;
+		m_nWork = 0;
+		m_keyCheck = 0;
+		m_candidateOffsetLow = 0;
+		m_candidateOffsetHigh = 0;
+		m_nCandidate = 0;
+		m_proofValue = m_disproofValue = quantizeValue(0.0f);
+		m_nVirtualVisit = 0;
 		m_solutionStatus = SOLUTION_UNKNOWN;
-		m_vCandidate.clear();
+		m_flag = 0;
+	}
+
+	inline bool isFree() const { return (m_flag & FLAG_USED) == 0; }
+	inline void setKey(HashKey key) { m_keyCheck = static_cast<unsigned int>(key >> 32); m_flag |= FLAG_USED; }
+	inline bool hasKey(HashKey key) const { return !isFree() && m_keyCheck == static_cast<unsigned int>(key >> 32); }
+	inline bool isPrefetched() const { return (m_flag & FLAG_PREFETCHED) != 0; }
+	inline void setPrefetched(bool bPrefetched) { m_flag = bPrefetched ? (m_flag | FLAG_PREFETCHED) : (m_flag & ~FLAG_PREFETCHED); }
+
+	// only the lower CANDIDATE_OFFSET_BIT_SIZE bits are kept, DFPNCandidateSlab compares offsets modulo 2^CANDIDATE_OFFSET_BIT_SIZE
+	inline void setCandidateOffset(ull offset) {
+		m_candidateOffsetLow = static_cast<unsigned int>(offset);
+		m_candidateOffsetHigh = static_cast<unsigned short>(offset >> 32);
+	}
+	inline ull getCandidateOffset() const { return (static_cast<ull>(m_candidateOffsetHigh) << 32) | m_candidateOffsetLow; }
+	inline void setProofNumber(double pn) { m_fProofNumber = (pn >= FLT_MAX) ? FLT_MAX : static_cast<float>(pn); }
+	inline void setDisproofNumber(double dn) { m_fDisproofNumber = (dn >= FLT_MAX) ? FLT_MAX : static_cast<float>(dn); }
+	inline void setProofValue(float value) { m_proofValue = quantizeValue(value); }
+	inline void setDisproofValue(float value) { m_disproofValue = quantizeValue(value); }
+	inline void setSolutionStatus(SOLUTION_STATUS status) { m_solutionStatus = status; }
+	inline void addWork(ull work) { m_nWork = static_cast<unsigned int>(min<ull>(m_nWork + work, UINT_MAX)); }
+	inline void addVirtualVisit(int virtualVisit) { m_nVirtualVisit = static_cast<unsigned short>(max(m_nVirtualVisit + virtualVisit, 0)); }
+
+	inline double getProofNumber() const { return (m_fProofNumber == FLT_MAX) ? DBL_MAX : m_fProofNumber; }
+	inline double getDisproofNumber() const { return (m_fDisproofNumber == FLT_MAX) ? DBL_MAX : m_fDisproofNumber; }
+	inline float getProofValue() const { return dequantizeValue(m_proofValue); }
+	inline float getDisproofValue() const { return dequantizeValue(m_disproofValue); }
+	inline SOLUTION_STATUS getSolutionStatus() const { return static_cast<SOLUTION_STATUS>(m_solutionStatus); }
+
+	inline bool isReplaceable() const { return m_nVirtualVisit == 0; }
+	inline ull getWork() const { return m_nWork; }
+
+private:
+	// value is in [0, NET_NUM_OUTPUT_V] for space complexity, otherwise in [-1, 1]
+	static inline float getMinValue() { return Configure::NET_VALUE_SPACE_COMPLEXITY ? 0.0f : -1.0f; }
+	static inline float getMaxValue() { return Configure::NET_VALUE_SPACE_COMPLEXITY ? Configure::NET_NUM_OUTPUT_V : 1.0f; }
+	static inline unsigned short quantizeValue(float value) {
+		float ratio = (value - getMinValue()) / (getMaxValue() - getMinValue());
+		return static_cast<unsigned short>(round(fmin(fmax(ratio, 0.0f), 1.0f) * USHRT_MAX));
+	}
+	static inline float dequantizeValue(unsigned short value) {
+		return getMinValue() + (getMaxValue() - getMinValue()) * value / USHRT_MAX;
 	}
 };
+static_assert(sizeof(DFPNTTEntry) == 32, "DFPNTTEntry should be packed into 32 bytes");
 
-class DFPNSolver : public BaseSolver
-{
+/*!
+	@brief  ring buffer of candidate moves (position and quantized policy) shared by all TT entries
+	        entries only keep the offset, candidates are overwritten by newer ones when it wraps around
+*/
+class DFPNCandidateSlab {
+	class DFPNCandidate {
+	public:
+		unsigned short m_position;
+		unsigned short m_probability;
+	};
+	static const ull OFFSET_MASK = (1ULL << DFPNTTEntry::CANDIDATE_OFFSET_BIT_SIZE) - 1;
+
+private:
+	boost::atomic<ull> m_head;
+	boost::atomic<ull> m_nReload;
+	const ull m_mask;
+	const ull m_size;
+	DFPNCandidate* m_candidate;
+
+public:
+	// size should be a power of 2, or 0 if no candidates are kept
+	DFPNCandidateSlab(ull size)
+		: m_head(0)
+		, m_nReload(0)
+		, m_mask(size - 1)
+		, m_size(size)
+		, m_candidate(size > 0 ? new DFPNCandidate[size] : nullptr)
+	{}
+	~DFPNCandidateSlab() { delete[] m_candidate; }
+
+	inline void clear() { m_head = 0; m_nReload = 0; }
+	inline ull getNumReload() const { return m_nReload.load(boost::memory_order_relaxed); }
+
+	ull store(const vector<pair<Move, float>>& vCandidate)
+	{
+		assert(("Candidate slab is too small", vCandidate.size() <= m_size));
+		ull offset = m_head.fetch_add(vCandidate.size(), boost::memory_order_relaxed);
+		for (size_t i = 0; i < vCandidate.size(); ++i) {
+			DFPNCandidate& candidate = m_candidate[(offset + i) & m_mask];
+			candidate.m_position = vCandidate[i].first.getPosition();
+			candidate.m_probability = static_cast<unsigned short>(round(vCandidate[i].second * USHRT_MAX));
+		}
+		return offset;
+	}
+
+	// fill children and return false if the candidates are already overwritten, then they have to be evaluated again
+	bool load(ull offset, int size, Color turnColor, TreeNode* pFirstChild)
+	{
+		if (!isAvailable(offset)) { m_nReload++; return false; }
+
+		TreeNode* pChild = pFirstChild;
+		for (int i = 0; i < size; ++i, ++pChild) {
+			const DFPNCandidate& candidate = m_candidate[(offset + i) & m_mask];
+			pChild->reset(Move(turnColor, candidate.m_position));
+			pChild->setProbability(static_cast<float>(candidate.m_probability) / USHRT_MAX);
+		}
+
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if (isAvailable(offset)) { return true; }
+		m_nReload++;
+		return false;
+	}
+
+private:
+	// offset may be truncated by DFPNTTEntry
+	inline bool isAvailable(ull offset) const { return ((m_head.load(boost::memory_order_acquire) - offset) & OFFSET_MASK) <= m_size; }
+};
+
+class DFPNSolverSharedData {
+public:
+	bool m_bTerminate;
+	boost::atomic<bool> m_bStop;
+	Game* m_pGame;
+	Network* m_pNetwork;
+	BucketHashTable<DFPNTTEntry> m_transpositionTable;
+	DFPNCandidateSlab m_candidateSlab;
+
+	DFPNSolverSharedData()
+		: m_bTerminate(false)
+		, m_bStop(false)
+		, m_pGame(nullptr)
+		, m_pNetwork(nullptr)
+		, m_transpositionTable(Configure::PNS_TT_BIT_SIZE)
+		, m_candidateSlab(getCandidateSlabSize())
+	{
+	}
+
+private:
+	static ull getCandidateSlabSize()
+	{
+		// vanilla PNS expands without network, no candidates are kept
+		if (Configure::PNS_MODE == 0) { return 0; }
+
+		ull size = 1ULL << Configure::PNS_TT_BIT_SIZE;
+		while (size < (1ULL << Configure::PNS_TT_BIT_SIZE) * Configure::PNS_TT_CANDIDATE_PER_ENTRY) { size <<= 1; }
+		return size;
+	}
+};
+
+class DFPNSolverSlave : public BaseSlave<DFPNSolverSharedData> {
 	static const int VANILLA_PNS = 0;
 	static const int POLICY_PNS = 1;
 	static const int FOCUSED_PNS = 2;
 
 public:
-	DFPNSolver() : m_transpositionTable(28) {
-		if (Configure::PNS_ENABLE_DFPN) { m_nodes = new TreeNode[1]; }
-		else { m_nodes = new TreeNode[1 + Configure::PNS_NUM_EXPANSION * Game::getMaxNumLegalAction()]; }
+	DFPNSolverSlave(int id, DFPNSolverSharedData& sharedData)
+		: BaseSlave(id, sharedData)
+		, m_nMID(0)
+		, m_nExpansion(0)
+		, m_nForward(0)
+		, m_network(nullptr)
+	{
 	}
-	~DFPNSolver() { delete[] m_nodes; }
+	~DFPNSolverSlave() { if (m_network != m_sharedData.m_pNetwork) { delete m_network; } }
 
-	void solve();
+	bool isOver() { return m_sharedData.m_bTerminate; }
+	void reset();
+	void doSlaveJob();
+
+	inline TreeNode* getRootNode() { return &m_root; }
+	inline ull getReExpansion() const { return m_nMID; }
+	inline ull getNumExpansion() const { return m_nExpansion; }
+	inline ull getNumForward() const { return m_nForward; }
+	static int getNumLimitSize(TreeNode* pNode);
+	static float getAdjustedValue(TreeNode* pNode);
 
 private:
-	void newTree();
+	void initialize();
 	void evaluate(TreeNode* pNode);
 	void setTerminalValue(TreeNode* pMPN);
 	void updateSolutionStatus(TreeNode* pNode);
 	void updatePNDN(TreeNode* pNode, double initPN = 1.0f, double initDN = 1.0f);
+	void updateChildrenFromTT(TreeNode* pNode, vector<int>& vVirtualVisit);
 	void MID(TreeNode* pNode, double PNthreshold, double DNthreshold);
 	void expandVanillaNode(TreeNode* pNode, vector<TreeNode>& vChildren);
-	void expandCNNNode(TreeNode* pNode, vector<pair<Move, float>>& vCandidate, vector<TreeNode>& vChildren, float& proofValue, float& disproofValue);
-	TreeNode* selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild, double& dMinDN, double& d2ndMinDN);
-	int getNumLimitSize(TreeNode* pNode);
-	float getAdjustedValue(TreeNode* pNode);
+	void expandCNNNode(TreeNode* pNode, vector<TreeNode>& vChildren, ull& candidateOffset, int& nCandidate, float& proofValue, float& disproofValue);
+	void evaluateInBatch(TreeNode* pNode, TreeNode* pMPN);
+	TreeNode* selectBestChild(TreeNode* pNode, double& dPnOfMinDNChild, double& dMinDN, double& d2ndMinDN, const vector<int>& vVirtualVisit);
 
-	void storeTTEntry(HashKey hashkey, DFPNTTEntry& entry);
+	void storeTTEntry(HashKey hashkey, DFPNTTEntry& entry, int virtualVisit = 0, bool bUpdateExisting = true);
+	bool updateTTEntryPNDN(unsigned int index, HashKey hashkey, const DFPNTTEntry& entry, int virtualVisit);
+	void updateTTEntry(TreeNode* pNode, ull candidateOffset, int nCandidate, float proofValue, float disproofValue, ull work, int virtualVisit);
 	DFPNTTEntry& getTTEntry(unsigned int index);
+	bool getTTEntry(HashKey hashkey, DFPNTTEntry& entry);
 	unsigned int getTTEntryIndex(HashKey hashkey);
-	void getPNDNfromTT(TreeNode* pNode);
-	inline bool findEntryInTT(HashKey hashkey) { return getTTEntryIndex(hashkey) != -1; }
+	bool getPNDNfromTT(TreeNode* pNode);
 
-	inline TreeNode* allocateNewNodes(int size);
-	inline TreeNode* getRootNode() { return &m_nodes[0]; }
+	inline bool isParallel() const { return Configure::NUM_THREAD > 1; }
+	inline double getVirtualDisproofNumber(double dn, int virtualVisit) {
+		// other threads are searching this child, make it look harder to disprove
+		if (dn == DBL_MAX || virtualVisit <= 0) { return dn; }
+		return dn + virtualVisit * (dn + 1.0f);
+	}
 	inline bool isExpansionEnd() {
-		if (Configure::SIM_CONTROL == SIM_CONTROL_TT_NODE) {
-			return m_transpositionTable.getCount() >= Configure::PNS_NUM_EXPANSION;
-		} else if (Configure::SIM_CONTROL == SIM_CONTROL_TIME) { 
+		if (m_sharedData.m_bStop) { return true; }
+
+		if (Configure::SIM_CONTROL == BaseSolver::SIM_CONTROL_TT_NODE) {
+			return m_sharedData.m_transpositionTable.getNumStore() >= static_cast<ull>(Configure::PNS_NUM_EXPANSION);
+		} else if (Configure::SIM_CONTROL == BaseSolver::SIM_CONTROL_TIME) {
 			m_timer.stop();
 			return m_timer.getElapsedTime().count() >= Configure::TIME_LIMIT;
 		}
@@ -86,10 +263,35 @@ private:
 		return false;
 	}
 
-	inline int getSolvedSimulation() { return m_transpositionTable.getCount(); }
+private:
+	ull m_nMID;
+	ull m_nExpansion;
+	ull m_nForward;
+	Game m_game;
+	TreeNode m_root;
+	StopTimer m_timer;
+	Network* m_network;
+};
+
+class DFPNSolver : public BaseSolver, public BaseMaster<DFPNSolverSharedData, DFPNSolverSlave>
+{
+public:
+	DFPNSolver();
+	~DFPNSolver();
+
+	void solve();
+	void summarizeSlavesData();
+
+private:
+	void newTree();
+
+	inline TreeNode* allocateNewNodes(int size);
+	inline TreeNode* getRootNode() { return &m_nodes[0]; }
+
+	inline int getSolvedSimulation() { return m_sharedData.m_transpositionTable.getNumStore(); }
 	inline ull getReExpansion() { return m_nMID; }
 	inline double getSolvedTime() {
-		m_timer.stop();  
+		m_timer.stop();
 		return m_timer.getElapsedTime().count();
 	}
 	inline TreeNode* getSolvedRootNode() { return &m_nodes[0]; }
@@ -107,6 +309,5 @@ private:
 	Game m_game;
 	TreeNode* m_nodes;
 	StopTimer m_timer;
-	OpenAddressHashTable<DFPNTTEntry> m_transpositionTable;
 };
 
@@ -1,6 +1,195 @@
 #include "MCTSSolver.h"
 #include "SgfLoader.h"
 
+void MCTSSolverSlave::reset()
+{
+	// each thread replays the problem on its own game
+	m_game.reset();
+	const vector<Move>& vMoves = m_sharedData.m_pGame->getMoves();
+	for (size_t i = 0; i < vMoves.size(); ++i) { m_game.play(vMoves[i]); }
+	m_backupMove = m_game.getMoves().size();
+	if (Configure::USE_NET && m_network->getModelName() != m_sharedData.m_pNetwork->getModelName()) {
+		m_network->loadModel(m_sharedData.m_pNetwork->getModelName());
+	}
+
+	m_vLeaf.resize(getBatchSize());
+	m_timer.reset();
+	m_timer.start();
+
+	return;
+}
+
+void MCTSSolverSlave::doSlaveJob()
+{
+	while (!isSimulationEnd()) {
+		// select leaves first, virtual losses lead the selections of one batch to different leaves
+		int nLeaf = 0;
+		for (int batchID = 0; batchID < getBatchSize(); ++batchID) {
+			if (m_sharedData.m_nSimulation++ >= Configure::MCTS_SIMULATION_COUNT && Configure::SIM_CONTROL == BaseSolver::SIM_CONTROL_COUNT) { break; }
+			if (selection(m_vLeaf[nLeaf])) {
+				if (Configure::USE_NET) { m_network->set_data(nLeaf, m_game); }
+				++nLeaf;
+			}
+			rollbackGame();
+		}
+		if (Configure::USE_NET && nLeaf > 0) { m_network->forward(); }
+
+		for (int batchID = 0; batchID < nLeaf; ++batchID) {
+			MCTSSolverLeaf& leaf = m_vLeaf[batchID];
+			replayGame(leaf);
+			evaluation(batchID, leaf);
+			expansion(leaf);
+			update(leaf);
+			rollbackGame();
+		}
+	}
+
+	return;
+}
+
+void MCTSSolverSlave::initialize()
+{
+	BaseSlave::initialize();
+
+	// the first thread shares the network of solver, others load their own
+	if (m_id == 0) { m_network = m_sharedData.m_pNetwork; }
+	else {
+		m_network = new Network(Configure::GPU_LIST[m_id % Configure::GPU_LIST.length()] - '0', Configure::MODEL_FILE);
+		if (Configure::USE_NET) { m_network->initialize(); }
+	}
+}
+
+bool MCTSSolverSlave::selection(MCTSSolverLeaf& leaf)
+{
+	MCTSSolver* pSolver = m_sharedData.m_pSolver;
+	TreeNode* pNode = pSolver->getRootNode();
+	leaf.m_bFoundInTT = false;
+	leaf.m_vSelectNodePath.clear();
+	leaf.m_vSelectNodePath.push_back(pNode);
+	addVirtualLoss(leaf.m_vSelectNodePath);
+	while (pNode->hasChildren()) {
+		// value bounds are read without lock, only updates are serialized by m_valueBoundLock
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		pNode = pSolver->selectChild(pNode);
+
+		// all children are solved by other threads, but the solution status of parent is not updated yet
+		if (pNode == nullptr) {
+			removeVirtualLoss(leaf.m_vSelectNodePath);
+			return false;
+		}
+
+		m_game.play(pNode->getMove());
+		leaf.m_vSelectNodePath.push_back(pNode);
+		addVirtualLoss(leaf.m_vSelectNodePath);
+		if (pSolver->foundEntryInTT(m_game)) {
+			leaf.m_bFoundInTT = true;
+			break;
+		}
+	}
+
+	return true;
+}
+
+void MCTSSolverSlave::evaluation(int batchID, MCTSSolverLeaf& leaf)
+{
+	m_sharedData.m_pSolver->evaluate(m_game, leaf.m_vSelectNodePath, m_network, batchID, m_fValue, m_vProbability);
+}
+
+void MCTSSolverSlave::expansion(MCTSSolverLeaf& leaf)
+{
+	if (leaf.m_bFoundInTT || m_game.isTerminal()) { return; }
+
+	// the same leaf may be selected and expanded by other threads
+	TreeNode* pLeaf = leaf.m_vSelectNodePath.back();
+	m_sharedData.m_expansionLock.lock();
+	if (!pLeaf->hasChildren()) { m_sharedData.m_pSolver->expandNode(pLeaf, m_game, m_vProbability); }
+	m_sharedData.m_expansionLock.unlock();
+}
+
+void MCTSSolverSlave::update(MCTSSolverLeaf& leaf)
+{
+	MCTSSolver* pSolver = m_sharedData.m_pSolver;
+	const vector<TreeNode*>& vSelectNodePath = leaf.m_vSelectNodePath;
+
+	// update value
+	float fValue = m_fValue;
+	vSelectNodePath.back()->setValue(fValue);
+	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { m_sharedData.m_valueBoundLock.lock(); }
+	for (int i = static_cast<int>(vSelectNodePath.size()) - 1; i >= 0; --i) {
+		TreeNode* pNode = vSelectNodePath[i];
+
+		if (Configure::NET_VALUE_WINLOSS) {
+			pSolver->updateByWinLose(pNode, fValue);
+			fValue = -fValue;
+		} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) { pSolver->updateBySpaceComplexity(pNode, fValue); }
+		else { assert(("Error configuration for training value target!", false)); }
+	}
+	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { m_sharedData.m_valueBoundLock.unlock(); }
+	removeVirtualLoss(vSelectNodePath);
+
+	if (!m_game.isTerminal() && !leaf.m_bFoundInTT) { return; }
+
+	// only one thread propagates solution status at a time, otherwise two threads may both miss that all children are loss
+	m_sharedData.m_solutionLock.lock();
+	pSolver->updateSolutionStatus(m_game, vSelectNodePath, leaf.m_bFoundInTT);
+	m_sharedData.m_solutionLock.unlock();
+}
+
+void MCTSSolverSlave::addVirtualLoss(const vector<TreeNode*>& vSelectNodePath)
+{
+	// add to the last selected node
+	const size_t last = vSelectNodePath.size() - 1;
+	vSelectNodePath[last]->getUctData().addVirtualLoss(Configure::MCTS_VIRTUAL_LOSS);
+	if (last > 0) { vSelectNodePath[last - 1]->syncChildStat(vSelectNodePath[last]); }
+}
+
+void MCTSSolverSlave::removeVirtualLoss(const vector<TreeNode*>& vSelectNodePath)
+{
+	// values updated before removing virtual losses are synced together
+	for (size_t i = 0; i < vSelectNodePath.size(); ++i) {
+		vSelectNodePath[i]->getUctData().removeVirtualLoss(Configure::MCTS_VIRTUAL_LOSS);
+		if (i > 0) { vSelectNodePath[i - 1]->syncChildStat(vSelectNodePath[i]); }
+	}
+}
+
+bool MCTSSolverSlave::isSimulationEnd()
+{
+	if (m_sharedData.m_pSolver->getRootNode()->getSolutionStatus() != SOLUTION_UNKNOWN) { return true; }
+
+	if (Configure::SIM_CONTROL == BaseSolver::SIM_CONTROL_COUNT) {
+		return m_sharedData.m_nSimulation >= Configure::MCTS_SIMULATION_COUNT;
+	} else if (Configure::SIM_CONTROL == BaseSolver::SIM_CONTROL_TIME) {
+		m_timer.stop();
+		return m_timer.getElapsedTime().count() >= Configure::TIME_LIMIT;
+	}
+	return false;
+}
+
+MCTSSolver::MCTSSolver()
+	: BaseMaster(Configure::NUM_THREAD)
+{
+	assert(("Number of thread should not be 0", Configure::NUM_THREAD > 0));
+
+	// single thread runs the sequential search without slaves
+	if (!isParallel()) { return; }
+
+	m_sharedData.m_pGame = &m_game;
+	m_sharedData.m_pNetwork = m_network;
+	m_sharedData.m_pSolver = this;
+	BaseMaster::initialize();
+}
+
+MCTSSolver::~MCTSSolver()
+{
+	if (!isParallel()) { return; }
+
+	// wake up all threads to let them leave
+	m_sharedData.m_bTerminate = true;
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->startRun(); }
+	for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->finishRun(); }
+	m_threads.join_all();
+}
+
 void MCTSSolver::solve()
 {
 	newTree();
@@ -8,6 +197,14 @@ void MCTSSolver::solve()
 	m_TT.clear();
 	m_timer.reset();
 	m_timer.start();
+
+	if (isParallel()) {
+		m_sharedData.m_nSimulation = 0;
+		for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->startRun(); }
+		for (int i = 0; i < m_nThread; ++i) { m_vSlaves[i]->finishRun(); }
+		summarizeSlavesData();
+		return;
+	}
 	
 	TreeNode* pRoot = getRootNode();
 	while (pRoot->getSolutionStatus() == SOLUTION_UNKNOWN && !isSimulationEnd()) {
@@ -31,7 +228,7 @@ void MCTSSolver::selection()
 		pNode = selectChild(pNode);
 		m_game.play(pNode->getMove());
 		m_vSelectNodePath.push_back(pNode);
-		if (foundEntryInTT()) {
+		if (foundEntryInTT(m_game)) {
 			m_bFoundInTT = true;
 			break;
 		}
@@ -46,68 +243,74 @@ void MCTSSolver::expansion()
 
 void MCTSSolver::evaluation()
 {
-	m_vSelectNodePath.back()->setHashkey(m_game.getHashKey());
+	if (Configure::USE_NET) {
+		m_network->set_data(0, m_game);
+		m_network->forward();
+	}
+	evaluate(m_game, m_vSelectNodePath, m_network, 0, m_fValue, m_vProbability);
+}
+
+void MCTSSolver::evaluate(Game& game, const vector<TreeNode*>& vSelectNodePath, Network* network, int batchID, float& fValue, vector<pair<Move, float>>& vProbability)
+{
+	vSelectNodePath.back()->setHashkey(game.getHashKey());
 	if (!Configure::USE_NET) {
 		int num = 0;
-		Color cTurn = m_game.getTurnColor();
-		while (!m_game.isTerminal()) {
+		Color cTurn = game.getTurnColor();
+		while (!game.isTerminal()) {
 			vector<int> legalMoves;
-			for (int p = 0; p < m_game.getMaxNumLegalAction(); ++p) {
-				if (m_game.isLegalMove(Move(m_game.getTurnColor(), p))) {
+			for (int p = 0; p < game.getMaxNumLegalAction(); ++p) {
+				if (game.isLegalMove(Move(game.getTurnColor(), p))) {
 					legalMoves.push_back(p);
 				}
 			}
 			int randMove = Random::nextInt(legalMoves.size());
-			m_game.play(Move(m_game.getTurnColor(), legalMoves[randMove]));
+			game.play(Move(game.getTurnColor(), legalMoves[randMove]));
 			++num;
 		}
-		m_fValue = (m_game.eval() == cTurn) ? -1. : 1.;
+		fValue = (game.eval() == cTurn) ? -1. : 1.;
 		for (int i = 0; i < num; ++i) {
-			m_game.undo();
+			game.undo();
 		}
-		m_vProbability.clear();
+		vProbability.clear();
 		for (int pos = 0; pos < Game::getMaxNumLegalAction(); ++pos) {
-			if (m_game.isLegalMove(Move(m_game.getTurnColor(), pos))) {
-				m_vProbability.push_back({Move(m_game.getTurnColor(), pos), -1.});
+			if (game.isLegalMove(Move(game.getTurnColor(), pos))) {
+				vProbability.push_back({Move(game.getTurnColor(), pos), -1.});
 			}
 		}
 		return;
 	}
 	
-	m_network->set_data(0, m_game);
-	m_network->forward();
-
 	// policy
-	m_vProbability = m_network->getProbability(0);
+	vProbability = network->getProbability(batchID);
 
 	// value
 	if (Configure::NET_VALUE_WINLOSS) {
-		m_fValue = m_network->getValue(0);
-		if (m_game.isTerminal()) {
-			Color winner = m_game.eval();
-			m_fValue = (winner == COLOR_NONE ? 0.0f : (winner == m_game.getTurnColor() ? 1.0f : -1.0f));
+		fValue = network->getValue(batchID);
+		if (game.isTerminal()) {
+			Color winner = game.eval();
+			fValue = (winner == COLOR_NONE ? 0.0f : (winner == game.getTurnColor() ? 1.0f : -1.0f));
 		}
 		// we should reverse the value since the last selected node is the inverse win rate of node color
-		m_fValue = -m_fValue;
+		fValue = -fValue;
 	} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
 		Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
 		Color proofColor = (Configure::AOT_PROOF_COLOR == COLOR_NONE) ? rootTurn : Configure::AOT_PROOF_COLOR;
-		m_fValue = m_network->getValue(0, proofColor);
-		if (m_game.isTerminal()) { m_fValue = (m_game.eval() == proofColor ? 0.0f : Configure::NET_NUM_OUTPUT_V); }
+		fValue = network->getValue(batchID, proofColor);
+		if (game.isTerminal()) { fValue = (game.eval() == proofColor ? 0.0f : Configure::NET_NUM_OUTPUT_V); }
 
 		// calculate value from root's perspective
-		for (int i = static_cast<int>(m_vSelectNodePath.size()) - 1; i > 0; i--) {
-			TreeNode* pNode = m_vSelectNodePath[i];
-			TreeNode* pParent = m_vSelectNodePath[i - 1];
+		for (int i = static_cast<int>(vSelectNodePath.size()) - 1; i > 0; i--) {
+			TreeNode* pNode = vSelectNodePath[i];
+			TreeNode* pParent = vSelectNodePath[i - 1];
 
 			// add log of branching factor to value (only for against proof color)
 			assert(("Branching Factor is negative or 0", pParent->getBranchingFactor() > 0));
 			Color disproofColor = AgainstColor(proofColor);
-			if (pNode->getMove().getColor() == disproofColor) { m_fValue += log10(pParent->getBranchingFactor()); }
+			if (pNode->getMove().getColor() == disproofColor) { fValue += log10(pParent->getBranchingFactor()); }
 		}
 
 		// rescale value to [0, Configure::NET_NUM_OUTPUT_V)
-		m_fValue = fmax(0, fmin(m_fValue, Configure::NET_NUM_OUTPUT_V - 1));
+		fValue = fmax(0, fmin(fValue, Configure::NET_NUM_OUTPUT_V - 1));
 	} else { assert(("Error configuration for training value target!", false)); }
 }
 
@@ -116,59 +319,55 @@ void MCTSSolver::update()
 	BaseMCTS::update();
 	if (!m_game.isTerminal() && !m_bFoundInTT) { return; }
 
+	updateSolutionStatus(m_game, m_vSelectNodePath, m_bFoundInTT);
+}
+
+void MCTSSolver::summarizeSlavesData()
+{
+	m_simulation = m_sharedData.m_nSimulation;
+	if (Configure::SIM_CONTROL == SIM_CONTROL_COUNT) { m_simulation = min(m_simulation, Configure::MCTS_SIMULATION_COUNT); }
+
+	return;
+}
+
+void MCTSSolver::updateSolutionStatus(Game& game, const vector<TreeNode*>& vSelectNodePath, bool bFoundInTT)
+{
 	// update solution status
-	if (m_bFoundInTT) {
-		TTentry& entry = m_TT.getEntry(m_TT.lookup(m_game.getTTHashKey()));
-		TreeNode* pMatchTT = m_vSelectNodePath.back();
+	if (bFoundInTT) {
+		TTentry& entry = m_TT.getEntry(m_TT.lookup(game.getTTHashKey()));
+		TreeNode* pMatchTT = vSelectNodePath.back();
 		pMatchTT->setSolutionStatus(entry.m_solutionStatus);
-	} else if (m_game.isTerminal()) {
-		Color winner = m_game.eval();
-		TreeNode* pTerminal = m_vSelectNodePath.back();
+	} else if (game.isTerminal()) {
+		Color winner = game.eval();
+		TreeNode* pTerminal = vSelectNodePath.back();
 		pTerminal->setSolutionStatus((pTerminal->getMove().getColor() == winner ? SOLUTION_WIN : SOLUTION_LOSS));
 	}
 
-	for (int i = static_cast<int>(m_vSelectNodePath.size()) - 1; i > 0; --i) {
-		TreeNode* pNode = m_vSelectNodePath[i];
-		TreeNode* pParent = m_vSelectNodePath[i - 1];
+	for (int i = static_cast<int>(vSelectNodePath.size()) - 1; i > 0; --i) {
+		TreeNode* pNode = vSelectNodePath[i];
+		TreeNode* pParent = vSelectNodePath[i - 1];
 
 		if (pNode->getSolutionStatus() == SOLUTION_WIN) {
 			pParent->setSolutionStatus(SOLUTION_LOSS);
-			m_game.undo();
-			storeTT(pParent);
+			game.undo();
+			storeTT(game, pParent);
 		} else if (pNode->getSolutionStatus() == SOLUTION_LOSS) {
-			m_game.undo();
+			game.undo();
 			if (isAllChildrenSolutionLoss(pParent)) {
 				pParent->setSolutionStatus(SOLUTION_WIN);
-				storeTT(pParent);
+				storeTT(game, pParent);
 			}
 			else { break; }
 		}
 	}
+
+	for (size_t i = 1; i < vSelectNodePath.size(); ++i) { vSelectNodePath[i - 1]->syncChildStat(vSelectNodePath[i]); }
 }
 
 TreeNode* MCTSSolver::selectChild(TreeNode* pNode)
 {
-	assert(("Pass a null pointer to selectChild", pNode));
-
-	TreeNode* pBest = nullptr;
-	TreeNode* pChild = pNode->getFirstChild();
-	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
-
-	float fBestScore = -DBL_MAX;
-	float fInitQValue = calculateInitQValue(pNode);
-	int nParentSimulation = pNode->getSimCount();
-	for (int i = 0; i < pNode->getNumChild(); ++i, ++pChild) {
-		// skip the node if it is proved
-		if (pChild->getSolutionStatus() != SOLUTION_UNKNOWN) { continue; }
-
-		float fMoveScore = calculateMoveScore(pChild, nParentSimulation, fInitQValue);
-		if (fMoveScore <= fBestScore) { continue; }
-
-		fBestScore = fMoveScore;
-		pBest = pChild;
-	}
-
-	return pBest;
+	// skip the node if it is proved
+	return selectPUCTChild(pNode, true);
 }
 
 bool MCTSSolver::isAllChildrenSolutionLoss(TreeNode* pNode)
@@ -225,22 +424,22 @@ string MCTSSolver::getUndoSgf(SgfLoader& sgfLoader)
 	return m_game.getGameRecord(tag, Game::getBoardSize());
 }
 
-bool MCTSSolver::foundEntryInTT()
+bool MCTSSolver::foundEntryInTT(Game& game)
 {
 	if (!Configure::USE_TRANSPOSITION_TABLE) { return false; }
 
-	return (m_TT.lookup(m_game.getTTHashKey()) != -1);
+	return (m_TT.lookup(game.getTTHashKey()) != -1);
 }
 
-void MCTSSolver::storeTT(TreeNode* pNode)
+void MCTSSolver::storeTT(Game& game, TreeNode* pNode)
 {
 	if (!Configure::USE_TRANSPOSITION_TABLE) { return; }
-	if (foundEntryInTT()) { return; }
+	if (foundEntryInTT(game)) { return; }
 	while (m_TT.isFull()) { cerr << "TT is full!" << endl; }
 
 	TTentry entry;
 	entry.m_solutionStatus = pNode->getSolutionStatus();
-	m_TT.store(m_game.getTTHashKey(), entry);
+	m_TT.store(game.getTTHashKey(), entry);
 
 	return;
 }
\ No newline at end of file
@@ -5,21 +5,105 @@
 #include "Network.h"
 #include "Random.h"
 #include "Timer.h"
+#include <boost/thread.hpp>
+#include "BaseMasterSlave.h"
+
+class MCTSSolver;
+
+class MCTSSolverSharedData {
+public:
+	bool m_bTerminate;
+	boost::atomic<int> m_nSimulation;
+	Game* m_pGame;
+	Network* m_pNetwork;
+	MCTSSolver* m_pSolver;
+	SpinLock m_expansionLock;
+	SpinLock m_solutionLock;
+	SpinLock m_valueBoundLock;
+
+	MCTSSolverSharedData()
+		: m_bTerminate(false)
+		, m_nSimulation(0)
+		, m_pGame(nullptr)
+		, m_pNetwork(nullptr)
+		, m_pSolver(nullptr)
+	{
+	}
+};
+
+/*!
+	@brief  worker of tree-parallel MCTS solver, all threads share the tree of MCTSSolver
+	        selected nodes get virtual losses, leaves of one thread are evaluated in a batch
+*/
+class MCTSSolverSlave : public BaseSlave<MCTSSolverSharedData> {
+	class MCTSSolverLeaf {
+	public:
+		bool m_bFoundInTT;
+		vector<TreeNode*> m_vSelectNodePath;
+	};
+
+public:
+	MCTSSolverSlave(int id, MCTSSolverSharedData& sharedData)
+		: BaseSlave(id, sharedData)
+		, m_backupMove(0)
+		, m_network(nullptr)
+	{
+	}
+	~MCTSSolverSlave() { if (m_network != m_sharedData.m_pNetwork) { delete m_network; } }
+
+	bool isOver() { return m_sharedData.m_bTerminate; }
+	void reset();
+	void doSlaveJob();
+
+private:
+	void initialize();
+	bool selection(MCTSSolverLeaf& leaf);
+	void evaluation(int batchID, MCTSSolverLeaf& leaf);
+	void expansion(MCTSSolverLeaf& leaf);
+	void update(MCTSSolverLeaf& leaf);
+	void addVirtualLoss(const vector<TreeNode*>& vSelectNodePath);
+	void removeVirtualLoss(const vector<TreeNode*>& vSelectNodePath);
+	bool isSimulationEnd();
+
+	inline int getBatchSize() const { return Configure::USE_NET ? Configure::NET_BATCH_SIZE : 1; }
+	inline void replayGame(const MCTSSolverLeaf& leaf) {
+		for (size_t i = 1; i < leaf.m_vSelectNodePath.size(); ++i) { m_game.play(leaf.m_vSelectNodePath[i]->getMove()); }
+	}
+	inline void rollbackGame() {
+		while (m_game.getMoves().size() > m_backupMove) { m_game.undo(); }
+	}
+
+private:
+	size_t m_backupMove;
+	Game m_game;
+	StopTimer m_timer;
+	Network* m_network;
+	vector<MCTSSolverLeaf> m_vLeaf;
+
+	// output from neural network
+	float m_fValue;
+	vector<pair<Move, float>> m_vProbability;
+};
+
+class MCTSSolver : public BaseMCTS, public BaseSolver, public BaseMaster<MCTSSolverSharedData, MCTSSolverSlave> {
+	friend class MCTSSolverSlave;
 
-class MCTSSolver : public BaseMCTS, public BaseSolver {
 public:
-	MCTSSolver() {}
-	~MCTSSolver() {}
+	MCTSSolver();
+	~MCTSSolver();
 
 	void solve();
 	void selection();
 	void expansion();
 	void evaluation();
 	void update();
+	void summarizeSlavesData();
 
 private:
 	TreeNode* selectChild(TreeNode* pNode);
 	bool isAllChildrenSolutionLoss(TreeNode* pNode);
+	void evaluate(Game& game, const vector<TreeNode*>& vSelectNodePath, Network* network, int batchID, float& fValue, vector<pair<Move, float>>& vProbability);
+	void updateSolutionStatus(Game& game, const vector<TreeNode*>& vSelectNodePath, bool bFoundInTT);
 	bool playSgfGame(SgfLoader& sgfLoader);
 	string getTreeInfo_r(TreeNode* pNode);
 	string getUndoSgf(SgfLoader& sgfLoader);
@@ -38,8 +122,9 @@ private:
 		m_timer.stop();
 		return m_timer.getElapsedTime().count();
 	}
-	bool foundEntryInTT();
-	void storeTT(TreeNode* pNode);
+	inline bool isParallel() const { return Configure::NUM_THREAD > 1; }
+	bool foundEntryInTT(Game& game);
+	void storeTT(Game& game, TreeNode* pNode);
 
 private:
 	StopTimer m_timer;
@@ -1,10 +1,14 @@
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include "GTPEngine.h"
 #include "MCTSSolver.h"
 #include "DFPNSolver.h"
 #include "ZeroServer.h"
 #include "ZeroSelfPlay.h"
+#include "Network.h"
+#include "Timer.h"
+#include "PUCTSelector.h"
 #include "GameConfigure.h"
 #include "ConfigureLoader.h"
 
@@ -35,6 +39,133 @@ void dfpnSolver() {
 	solver.runSolver();
 }
 
+void netBenchmark() {
+	// positions per second for each batch size (power of 2 up to NET_BATCH_SIZE), each measured for a few seconds
+	const double dBenchmarkTime = 3.0;
+	Game game;
+	game.reset();
+	for (int batchSize = 1; batchSize <= Configure::NET_BATCH_SIZE; batchSize *= 2) {
+		Network network(Configure::GPU_LIST[0] - '0', Configure::MODEL_FILE);
+		network.initialize(batchSize);
+		for (int i = 0; i < batchSize; ++i) { network.set_data(i, game); }
+		network.forward();
+
+		int nForward = 0;
+		StopTimer timer;
+		timer.reset();
+		timer.start();
+		do {
+			for (int i = 0; i < batchSize; ++i) { network.set_data(i, game); }
+			network.forward();
+			++nForward;
+			timer.stop();
+		} while (timer.getElapsedTime().count() < dBenchmarkTime);
+
+		double dTime = timer.getElapsedTime().count();
+		cout << "batch size: " << batchSize
+			<< ", positions/sec: " << batchSize * nForward / dTime
+			<< ", ms/batch: " << dTime * 1000 / nForward << endl;
+	}
+}
+
+// MCTS with one expanded root of random children statistics, for comparing the selection paths
+class PUCTBenchmarkMCTS : public BaseMCTS {
+public:
+	void evaluation() {}
+
+	void initialize(int nParentSimulation) {
+		vector<pair<Move, float>> vProbability;
+		for (int pos = 0; pos < Game::getMaxNumLegalAction(); ++pos) {
+			Move move(m_game.getTurnColor(), pos);
+			if (m_game.isLegalMove(move)) { vProbability.push_back({ move, Random::nextReal(1.0f) }); }
+		}
+		expandNode(m_pRoot, m_game, vProbability);
+
+		// random mean (space complexity value or win rate) and count for each child
+		const int nChild = m_pRoot->getNumChild();
+		m_pRoot->getUctData().reset(0, nParentSimulation);
+		TreeNode* pChild = m_pRoot->getFirstChild();
+		for (int i = 0; i < nChild; ++i, ++pChild) {
+			int nCount = Random::nextInt(2 * nParentSimulation / nChild + 1);
+			float fMean = Configure::NET_VALUE_WINLOSS ? Random::nextReal(2.0f) - 1 : Random::nextReal(Configure::NET_NUM_OUTPUT_V);
+			pChild->getUctData().reset(fMean, nCount);
+			if (nCount > 0 && Configure::NET_VALUE_SPACE_COMPLEXITY) { m_valueBound.add(fMean); }
+			m_pRoot->syncChildStat(pChild);
+		}
+	}
+
+	inline TreeNode* selectByPackedChildren() { return selectPUCTChild(m_pRoot, false); }
+
+	// the previous path, calculateMoveScore for each child node
+	TreeNode* selectByMoveScore() {
+		TreeNode* pBest = nullptr;
+		TreeNode* pChild = m_pRoot->getFirstChild();
+		float fBestScore = -DBL_MAX;
+		float fInitQValue = calculateInitQValue(m_pRoot);
+		int nParentSimulation = m_pRoot->getSimCount();
+		for (int i = 0; i < m_pRoot->getNumChild(); ++i, ++pChild) {
+			float fMoveScore = calculateMoveScore(pChild, nParentSimulation, fInitQValue);
+			if (fMoveScore <= fBestScore) { continue; }
+
+			fBestScore = fMoveScore;
+			pBest = pChild;
+		}
+		return pBest;
+	}
+
+private:
+	float calculateMoveScore(TreeNode* pNode, int nParentSim, float fInitQValue) {
+		// U(s,a) = c_puct * sqrt(ln( N(s,b))) / N(s,a)
+		float fValueU = sqrt(2.) * sqrt(log(nParentSim) / (1. + pNode->getSimCount()));
+
+		// U(s,a) = c_puct * P(s,a) * sqrt(sum of N(s,b)) / (1 + N(s,a))
+		if (Configure::USE_NET) {
+			float fValuePa = Configure::MCTS_USE_NOISE_AT_ROOT ? pNode->getProbabilityWithNoise() : pNode->getProbability();
+			float fPUCTBias = log((1 + nParentSim + 19652) / 19652) + Configure::MCTS_PUCT_BIAS;
+			fPUCTBias = (Configure::MCTS_PUCT_BIAS == 0 ? 0 : fPUCTBias);
+			fValueU = fPUCTBias * fValuePa * sqrt(nParentSim) / (1 + pNode->getSimCount());
+		}
+
+		// Q(s,a)
+		Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
+		float fValueQ = pNode->getPUCTValueQ(m_valueBound, fInitQValue, rootTurn);
+
+		// action value = U(s,a) + Q(s,a)
+		return fValueU + Configure::MCTS_Q_WEIGHT * fValueQ;
+	}
+};
+
+void puctBenchmark() {
+	// selections per second of a root with random children (maximum number of actions), each measured for a few seconds
+	const double dBenchmarkTime = 3.0;
+	const int nParentSimulation = Configure::MCTS_SIMULATION_COUNT;
+	PUCTBenchmarkMCTS mcts;
+	mcts.initialize(nParentSimulation);
+
+	vector<pair<string, function<TreeNode*()>>> vPath = {
+		{ "calculateMoveScore", [&mcts]() { return mcts.selectByMoveScore(); } },
+		{ "packed children", [&mcts]() { return mcts.selectByPackedChildren(); } }
+	};
+	cout << "number of children: " << mcts.getRootNode()->getNumChild() << ", runtime kernel: " << PUCTSelector::getInstructionSetName() << endl;
+	for (auto path : vPath) {
+		long long nSelection = 0;
+		TreeNode* pSelected = nullptr;
+		StopTimer timer;
+		timer.reset();
+		timer.start();
+		do {
+			for (int i = 0; i < 1000; ++i) { pSelected = path.second(); }
+			nSelection += 1000;
+			timer.stop();
+		} while (timer.getElapsedTime().count() < dBenchmarkTime);
+
+		double dTime = timer.getElapsedTime().count();
+		cout << path.first << ": selections/sec: " << nSelection / dTime
+			<< ", ns/selection: " << dTime * 1e9 / nSelection
+			<< ", selected: " << pSelected->getMove().toGtpString(Game::getBoardSize()) << endl;
+	}
+}
+
 void genConfiguration(ConfigureLoader& cl, string sConfFile) {
 	// check configure file is exist
 	ifstream f(sConfFile);
@@ -89,6 +220,8 @@ int main(int argc, char* argv[]) {
 	else if (sMode == "sp") { selfPlay(); }
 	else if (sMode == "mcts_solver") { mctsSolver(); }
 	else if (sMode == "dfpn_solver") { dfpnSolver(); }
+	else if (sMode == "net_benchmark") { netBenchmark(); }
+	else if (sMode == "puct_benchmark") { puctBenchmark(); }
 	else { cerr << "error mode with " << sMode << endl; }
 
 	return 0;
@@ -3,12 +3,19 @@
 #include <fstream>
 #include <numeric>
 
-void Network::initialize()
+void Network::initialize(int batchSize/* = Configure::NET_BATCH_SIZE*/)
 {
-	// set GPU device & inputs
-	assert(("Invalid GPU device number", m_gpuId >= 0));
-	m_batchSize = (Configure::NET_ROTATION == 0) ? Configure::NET_BATCH_SIZE : Configure::NET_BATCH_SIZE * Configure::NET_ROTATION;
-	m_inputs = torch::zeros({m_batchSize, Game::getNumChannels(), Game::getBoardSize(), Game::getBoardSize()}, torch::Device(torch::kCUDA, m_gpuId));
+	// set device & inputs
+	if (isCPU()) {
+		if (Configure::NET_CPU_NUM_THREAD > 0) { torch::set_num_threads(Configure::NET_CPU_NUM_THREAD); }
+	} else {
+		assert(("Invalid GPU device number", m_gpuId >= 0));
+		assert(("Only fp32 is supported on GPU", Configure::NET_PRECISION == "fp32"));
+	}
+	m_batchSize = (Configure::NET_ROTATION == 0) ? batchSize : batchSize * Configure::NET_ROTATION;
+	// games write features into the (pinned) host buffer, which is copied to device once per forward
+	m_hostInputs = torch::zeros({m_batchSize, Game::getNumChannels(), Game::getBoardSize(), Game::getBoardSize()}, torch::dtype(torch::kFloat).pinned_memory(!isCPU()));
+	m_inputs = isCPU() ? m_hostInputs : torch::zeros({m_batchSize, Game::getNumChannels(), Game::getBoardSize(), Game::getBoardSize()}, getDevice());
 
 	if (!loadModel(m_sModelName)) {
 		cerr << "Error when loading the model \"" << m_sModelName << "\"" << endl;
@@ -26,8 +33,10 @@ bool Network::loadModel(string sModelName)
 	m_sModelName = sModelName;
 
 	try {
-		m_module = torch::jit::load(m_sModelName, torch::Device(torch::kCUDA, m_gpuId));
+		m_module = torch::jit::load(m_sModelName, getDevice());
 		m_module.eval();
+		if (isBFloat16()) { m_module.to(torch::kBFloat16); }
+		if (Configure::NET_OPTIMIZE_FOR_INFERENCE) { m_module = torch::jit::optimize_for_inference(m_module); }
 	}
 	catch (const c10::Error& e) {
 		return false;
@@ -38,27 +47,31 @@ bool Network::loadModel(string sModelName)
 
 void Network::forward()
 {
-	auto res = m_module.forward(vector<torch::jit::IValue>{m_inputs});
+	torch::NoGradGuard noGrad;
+
+	// the copy is finished before reading outputs to CPU below, so the host buffer can be reused after forward
+	if (!isCPU()) { m_inputs.copy_(m_hostInputs, true); }
+	auto res = m_module.forward(vector<torch::jit::IValue>{isBFloat16() ? m_inputs.to(torch::kBFloat16) : m_inputs});
 	auto res_tuple = res.toTuple();
 
 	// policy
-	auto probability = torch::softmax(res_tuple->elements()[0].toTensor(), 1).to(at::kCPU);
+	auto probability = torch::softmax(res_tuple->elements()[0].toTensor().to(torch::kFloat), 1).to(at::kCPU);
 	m_vProbability.resize(probability.numel());
 	copy(probability.data_ptr<float>(), probability.data_ptr<float>() + probability.numel(), m_vProbability.begin());
 
 	if (Configure::NET_VALUE_WINLOSS) {
 		// value
-		auto value = res_tuple->elements()[1].toTensor().to(at::kCPU);
+		auto value = res_tuple->elements()[1].toTensor().to(torch::kFloat).to(at::kCPU);
 		m_vValue.resize(value.numel());
 		copy(value.data_ptr<float>(), value.data_ptr<float>() + value.numel(), m_vValue.begin());
 	} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
 		// black value
-		auto blackValue = torch::softmax(res_tuple->elements()[1].toTensor(), 1).to(at::kCPU);
+		auto blackValue = torch::softmax(res_tuple->elements()[1].toTensor().to(torch::kFloat), 1).to(at::kCPU);
 		m_vBlackValue.resize(blackValue.numel());
 		copy(blackValue.data_ptr<float>(), blackValue.data_ptr<float>() + blackValue.numel(), m_vBlackValue.begin());
 
 		// white value
-		auto whiteValue = torch::softmax(res_tuple->elements()[2].toTensor(), 1).to(at::kCPU);
+		auto whiteValue = torch::softmax(res_tuple->elements()[2].toTensor().to(torch::kFloat), 1).to(at::kCPU);
 		m_vWhiteValue.resize(whiteValue.numel());
 		copy(whiteValue.data_ptr<float>(), whiteValue.data_ptr<float>() + whiteValue.numel(), m_vWhiteValue.begin());
 	} else { assert(("Error configuration for training value target!", false)); }
@@ -148,13 +161,9 @@ void Network::set_data_(int batchID, const Game& game, SymmetryType type)
 	Color turnColor = game.getTurnColor();
 	m_vColor[batchID] = turnColor;
 	m_vSymmetry[batchID] = type;
-	m_inputs[batchID] = torch::from_blob(game.getFeatures(type).data(), {Game::getNumChannels(), Game::getBoardSize(), Game::getBoardSize()});
+	game.getFeatures(m_hostInputs.data_ptr<float>() + batchID * Game::getNumChannels() * Game::getBoardSize() * Game::getBoardSize(), type);
 	int shift = batchID * Game::getMaxNumLegalAction();
-	for (int pos = 0; pos < Game::getMaxNumLegalAction(); ++pos) {
-		const Move m(turnColor, pos);
-		m_vBadMove[shift + pos] = game.isBadMove(m);
-		m_vLegalMove[shift + pos] = game.isLegalMove(m);
-	}
+	game.getLegalMoveMask(&m_vLegalMove[shift], &m_vBadMove[shift]);
 }
 
 float Network::getValue(int batchID, const vector<float>& value)
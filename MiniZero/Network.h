@@ -10,6 +10,7 @@ private:
 	int m_batchSize;
 	string m_sModelName;
 	torch::Tensor m_inputs;
+	torch::Tensor m_hostInputs;
 	torch::jit::script::Module m_module;
 
 	vector<float> m_vValue;
@@ -30,7 +31,7 @@ public:
 	}
 	~Network() {}
 
-	void initialize();
+	void initialize(int batchSize = Configure::NET_BATCH_SIZE);
 	bool loadModel(string sModelName);
 	void forward();
 	void set_data(int batchID, const Game& game, SymmetryType type = SYM_NORMAL);
@@ -42,8 +43,11 @@ public:
 
 	inline int getGPUID() const { return m_gpuId; }
 	inline string getModelName() const { return m_sModelName; }
+	static inline bool isCPU() { return Configure::NET_DEVICE == "cpu"; }
 
 private:
+	static inline bool isBFloat16() { return Configure::NET_PRECISION == "bf16"; }
+	inline torch::Device getDevice() const { return isCPU() ? torch::Device(torch::kCPU) : torch::Device(torch::kCUDA, m_gpuId); }
 	void set_data_(int batchID, const Game& game, SymmetryType type);
 	float getValue(int batchID, const vector<float>& value);
 };
\ No newline at end of file
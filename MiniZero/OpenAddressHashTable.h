@@ -1,89 +1,120 @@
 #pragma once
 
+#include "SpinLock.h"
+
 typedef unsigned long long HashKey;
 
 template<class _data> class OpenAddressHashTable;
 template<class _data> class OpenAddressHashTableEntry {
 	friend class OpenAddressHashTable<_data>;
 private:
-	bool m_bIsFree;
+	static const char ENTRY_FREE = 0;
+	static const char ENTRY_WRITING = 1;
+	static const char ENTRY_USED = 2;
+
+	boost::atomic<char> m_state;
+	SpinLock m_lock;
 	HashKey m_key;
 
 public:
 	_data m_data;
-	OpenAddressHashTableEntry() : m_bIsFree(true) {}
+	OpenAddressHashTableEntry() : m_state(ENTRY_FREE) {}
 	inline void setEntry(HashKey key) { m_key = key; }
 	inline void clear()
 	{
 		m_data.clear();
-		m_bIsFree = true;
+		m_state.store(ENTRY_FREE, boost::memory_order_relaxed);
 	}
 	inline HashKey getHashKey() const { return m_key; }
+	inline void lock() { m_lock.lock(); }
+	inline void unlock() { m_lock.unlock(); }
 };
 
+/*!
+	@brief  linear probing hash table, lookup and store can be called by multiple threads at the same time
+	        (an entry is claimed by CAS on its state; m_data written after store should be guarded by lock/unlock)
+*/
 template<class _data> class OpenAddressHashTable {
 	typedef unsigned int IndexType;
+	typedef OpenAddressHashTableEntry<_data> Entry;
 private:
-	IndexType m_count;
+	boost::atomic<IndexType> m_count;
 	const IndexType m_mask;
 	const size_t m_size;
 
 public:
-	OpenAddressHashTableEntry<_data>* m_entry;
+	Entry* m_entry;
 
 	OpenAddressHashTable(int bitSize = 12)
 		: m_mask((1 << bitSize) - 1)
 		, m_count(0)
 		, m_size(1 << bitSize)
-		, m_entry(new OpenAddressHashTableEntry<_data>[1ULL << bitSize])
+		, m_entry(new Entry[1ULL << bitSize])
 	{}
 
 	~OpenAddressHashTable() { delete[] m_entry; }
 
-	IndexType getCount() const { return m_count; }
+	IndexType getCount() const { return m_count.load(boost::memory_order_relaxed); }
 
-	bool isFull() const { return m_count >= m_size; }
+	bool isFull() const { return getCount() >= m_size; }
 
 	IndexType lookup(const HashKey& key) const
 	{
 		IndexType index = static_cast<IndexType>(key)&m_mask;
 
 		while (true) {
-			const OpenAddressHashTableEntry<_data>& entry = m_entry[index];
+			const Entry& entry = m_entry[index];
+			char state = entry.m_state.load(boost::memory_order_acquire);
 
-			if (!entry.m_bIsFree) {
-				if (entry.m_key == key) { return index; }
-				else { index = (index + 1)&m_mask; }
-			}
-			else {
-				return -1;
-			}
+			if (state == Entry::ENTRY_FREE) { return -1; }
+			else if (state == Entry::ENTRY_WRITING) { continue; } // wait until the key is visible
+			else if (entry.m_key == key) { return index; }
+			else { index = (index + 1)&m_mask; }
 		}
 		return -1;
 	}
 
 	void store(const HashKey& key, const _data& data)
+	{
+		bool bInserted;
+		store(key, data, bInserted);
+	}
+
+	// if key is already in table (e.g. stored by other thread), data is not written and bInserted is false
+	IndexType store(const HashKey& key, const _data& data, bool& bInserted)
 	{
 		IndexType index = static_cast<IndexType>(key)&m_mask;
 		while (true) {
-			OpenAddressHashTableEntry<_data>& entry = m_entry[index];
+			Entry& entry = m_entry[index];
+			char state = entry.m_state.load(boost::memory_order_acquire);
 
-			if (entry.m_bIsFree) {
+			if (state == Entry::ENTRY_FREE) {
+				if (!entry.m_state.compare_exchange_strong(state, Entry::ENTRY_WRITING, boost::memory_order_acq_rel)) { continue; }
 				entry.m_key = key;
 				entry.m_data = data;
-				entry.m_bIsFree = false;
+				entry.m_state.store(Entry::ENTRY_USED, boost::memory_order_release);
 				m_count++;
-				break;
+				bInserted = true;
+				return index;
+			}
+			else if (state == Entry::ENTRY_WRITING) { continue; }
+			else if (entry.m_key == key) {
+				bInserted = false;
+				return index;
 			}
 			else {
 				index = (index + 1)&m_mask;
 			}
 		}
+		return -1;
 	}
 
+	inline void lock(IndexType index) { m_entry[index].lock(); }
+	inline void unlock(IndexType index) { m_entry[index].unlock(); }
+
 	void clear()
 	{
 		m_count = 0;
 		for (uint i = 0; i < m_size; ++i) { m_entry[i].clear(); }
 	}
-};
\ No newline at end of file
+};
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "PUCTSelector.h"
+#include <limits>
+#include <immintrin.h>
+
+namespace {
+
+inline float calculateScore(float fPrior, float fCount, float fValueQ, float fScaleU, float fQWeight)
+{
+	return fScaleU * fPrior / (1 + fCount) + fQWeight * fValueQ;
+}
+
+// continue scalar argmax from index begin, ties are resolved by the smaller index
+inline int argmaxTail(const float* pPrior, const float* pCount, const float* pValueQ, int begin, int size, float fScaleU, float fQWeight, float fBestScore, int bestIndex)
+{
+	for (int i = begin; i < size; ++i) {
+		float fScore = calculateScore(pPrior[i], pCount[i], pValueQ[i], fScaleU, fQWeight);
+		if (fScore <= fBestScore) { continue; }
+
+		fBestScore = fScore;
+		bestIndex = i;
+	}
+	return bestIndex;
+}
+
+// reduce the best score of each lane, ties are resolved by the smaller index
+inline int reduceLanes(const float* pLaneScore, const int* pLaneIndex, int nLane, float& fBestScore)
+{
+	int bestIndex = -1;
+	fBestScore = -std::numeric_limits<float>::infinity();
+	for (int i = 0; i < nLane; ++i) {
+		if (pLaneIndex[i] == -1) { continue; }
+		if (pLaneScore[i] < fBestScore || (pLaneScore[i] == fBestScore && pLaneIndex[i] > bestIndex)) { continue; }
+
+		fBestScore = pLaneScore[i];
+		bestIndex = pLaneIndex[i];
+	}
+	return bestIndex;
+}
+
+}
+
+int PUCTSelector::argmaxScalar(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight)
+{
+	return argmaxTail(pPrior, pCount, pValueQ, 0, size, fScaleU, fQWeight, -std::numeric_limits<float>::infinity(), -1);
+}
+
+__attribute__((target("avx2")))
+int PUCTSelector::argmaxAVX2(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight)
+{
+	const __m256 vOne = _mm256_set1_ps(1.0f);
+	const __m256 vScaleU = _mm256_set1_ps(fScaleU);
+	const __m256 vQWeight = _mm256_set1_ps(fQWeight);
+	const __m256i vStep = _mm256_set1_epi32(8);
+	__m256 vBestScore = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+	__m256i vBestIndex = _mm256_set1_epi32(-1);
+	__m256i vIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int i = 0;
+	for (; i + 8 <= size; i += 8) {
+		__m256 vU = _mm256_div_ps(_mm256_mul_ps(vScaleU, _mm256_loadu_ps(pPrior + i)), _mm256_add_ps(vOne, _mm256_loadu_ps(pCount + i)));
+		__m256 vScore = _mm256_add_ps(vU, _mm256_mul_ps(vQWeight, _mm256_loadu_ps(pValueQ + i)));
+		__m256 vMask = _mm256_cmp_ps(vScore, vBestScore, _CMP_GT_OQ);
+		vBestScore = _mm256_blendv_ps(vBestScore, vScore, vMask);
+		vBestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(vBestIndex), _mm256_castsi256_ps(vIndex), vMask));
+		vIndex = _mm256_add_epi32(vIndex, vStep);
+	}
+
+	float laneScore[8];
+	int laneIndex[8];
+	_mm256_storeu_ps(laneScore, vBestScore);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(laneIndex), vBestIndex);
+
+	float fBestScore;
+	int bestIndex = reduceLanes(laneScore, laneIndex, 8, fBestScore);
+	return argmaxTail(pPrior, pCount, pValueQ, i, size, fScaleU, fQWeight, fBestScore, bestIndex);
+}
+
+__attribute__((target("avx512f")))
+int PUCTSelector::argmaxAVX512(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight)
+{
+	const __m512 vOne = _mm512_set1_ps(1.0f);
+	const __m512 vScaleU = _mm512_set1_ps(fScaleU);
+	const __m512 vQWeight = _mm512_set1_ps(fQWeight);
+	const __m512i vStep = _mm512_set1_epi32(16);
+	__m512 vBestScore = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+	__m512i vBestIndex = _mm512_set1_epi32(-1);
+	__m512i vIndex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	int i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m512 vU = _mm512_div_ps(_mm512_mul_ps(vScaleU, _mm512_loadu_ps(pPrior + i)), _mm512_add_ps(vOne, _mm512_loadu_ps(pCount + i)));
+		__m512 vScore = _mm512_add_ps(vU, _mm512_mul_ps(vQWeight, _mm512_loadu_ps(pValueQ + i)));
+		__mmask16 mask = _mm512_cmp_ps_mask(vScore, vBestScore, _CMP_GT_OQ);
+		vBestScore = _mm512_mask_blend_ps(mask, vBestScore, vScore);
+		vBestIndex = _mm512_mask_blend_epi32(mask, vBestIndex, vIndex);
+		vIndex = _mm512_add_epi32(vIndex, vStep);
+	}
+
+	float laneScore[16];
+	int laneIndex[16];
+	_mm512_storeu_ps(laneScore, vBestScore);
+	_mm512_storeu_si512(laneIndex, vBestIndex);
+
+	float fBestScore;
+	int bestIndex = reduceLanes(laneScore, laneIndex, 16, fBestScore);
+	return argmaxTail(pPrior, pCount, pValueQ, i, size, fScaleU, fQWeight, fBestScore, bestIndex);
+}
+
+std::string PUCTSelector::getInstructionSetName()
+{
+	ArgmaxFunction function = getArgmaxFunction();
+	if (function == argmaxAVX512) { return "avx512"; }
+	else if (function == argmaxAVX2) { return "avx2"; }
+	return "scalar";
+}
+
+PUCTSelector::ArgmaxFunction PUCTSelector::getArgmaxFunction()
+{
+	static const ArgmaxFunction function = []() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) { return &PUCTSelector::argmaxAVX512; }
+		if (__builtin_cpu_supports("avx2")) { return &PUCTSelector::argmaxAVX2; }
+		return &PUCTSelector::argmaxScalar;
+	}();
+	return function;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+/*!
+	@brief  argmax of PUCT score over packed children
+	        score[i] = fScaleU * prior[i] / (1 + count[i]) + fQWeight * Q[i]
+	        return the first index with maximum score (-1 if size is 0)
+	        the kernel is selected at runtime by the instruction sets supported by CPU
+*/
+class PUCTSelector {
+public:
+	typedef int (*ArgmaxFunction)(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight);
+
+	static inline int argmax(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight) {
+		return getArgmaxFunction()(pPrior, pCount, pValueQ, size, fScaleU, fQWeight);
+	}
+
+	static int argmaxScalar(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight);
+	static int argmaxAVX2(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight);
+	static int argmaxAVX512(const float* pPrior, const float* pCount, const float* pValueQ, int size, float fScaleU, float fQWeight);
+
+	static std::string getInstructionSetName();
+
+private:
+	static ArgmaxFunction getArgmaxFunction();
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+#include <unistd.h>
+#include <zlib.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "Configure.h"
+#include "ReplayBuffer.h"
+
+using namespace std;
+
+/*!
+	@brief  batch of self-play games sent from worker to server
+	        frame   = "Self-play-batch <num games> <raw size> <compressed size>\n" followed by the compressed payload
+	        payload = (uint32 length, game string, replay record) for each game, compressed by zlib
+	        the header is a text line, so it is read by the same line protocol as other commands
+	        replay records are converted by workers (see ReplayRecord::toBinaryString), so the server writes them directly
+	        (only uint32 0 if the game can not be converted)
+*/
+class SelfPlayBatch {
+public:
+	static string getFrameName() { return "Self-play-batch"; }
+
+	static string encode(const vector<string>& vGames)
+	{
+		string sRaw;
+		for (const string& sGame : vGames) {
+			uint32_t length = sGame.length();
+			sRaw.append(reinterpret_cast<const char*>(&length), sizeof(uint32_t));
+			sRaw.append(sGame);
+
+			// game is "<move number> <sgf>", details after '*' in comments are ignored by ReplayRecord::parseFromSgf
+			SgfLoader sgfLoader;
+			ReplayRecord replayRecord;
+			size_t sgfStart = sGame.find('(');
+			if (sgfStart != string::npos && sgfLoader.parseFromString(sGame.substr(sgfStart)) && replayRecord.parseFromSgf(sgfLoader, Game::getBoardSize())) {
+				sRaw.append(replayRecord.toBinaryString());
+			} else {
+				const uint32_t emptySize = 0;
+				sRaw.append(reinterpret_cast<const char*>(&emptySize), sizeof(uint32_t));
+			}
+		}
+
+		uLongf compressedSize = compressBound(sRaw.length());
+		string sCompressed(compressedSize, '\0');
+		if (compress2(reinterpret_cast<Bytef*>(&sCompressed[0]), &compressedSize, reinterpret_cast<const Bytef*>(sRaw.data()), sRaw.length(), Z_BEST_SPEED) != Z_OK) {
+			cerr << "[SelfPlayBatch] compress failed" << endl;
+			return "";
+		}
+		sCompressed.resize(compressedSize);
+
+		return getFrameName() + " " + to_string(vGames.size()) + " " + to_string(sRaw.length()) + " " + to_string(sCompressed.length()) + "\n" + sCompressed;
+	}
+
+	// each game is decoded as (game string, replay record with its uint32 size, empty if not converted)
+	static bool decode(const string& sCompressed, size_t rawSize, int numGames, vector<pair<string, string>>& vGames)
+	{
+		string sRaw(rawSize, '\0');
+		uLongf size = rawSize;
+		if (uncompress(reinterpret_cast<Bytef*>(&sRaw[0]), &size, reinterpret_cast<const Bytef*>(sCompressed.data()), sCompressed.length()) != Z_OK || size != rawSize) { return false; }
+
+		size_t offset = 0;
+		vGames.clear();
+		while (offset + sizeof(uint32_t) <= rawSize) {
+			uint32_t length;
+			memcpy(&length, sRaw.data() + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+			if (offset + length > rawSize) { return false; }
+
+			string sGame = sRaw.substr(offset, length);
+			offset += length;
+
+			uint32_t replaySize;
+			if (offset + sizeof(uint32_t) > rawSize) { return false; }
+			memcpy(&replaySize, sRaw.data() + offset, sizeof(uint32_t));
+			if (offset + sizeof(uint32_t) + replaySize > rawSize || !isValidReplayRecord(sRaw.data() + offset + sizeof(uint32_t), replaySize)) { return false; }
+
+			vGames.push_back({ sGame, (replaySize == 0 ? "" : sRaw.substr(offset, sizeof(uint32_t) + replaySize)) });
+			offset += sizeof(uint32_t) + replaySize;
+		}
+
+		return offset == rawSize && vGames.size() == static_cast<size_t>(numGames);
+	}
+
+private:
+	// the sizes of moves and visits should match the payload size, so a broken record is never written to replay files
+	static bool isValidReplayRecord(const char* pPayload, uint32_t size)
+	{
+		if (size == 0) { return true; }
+		if (size < sizeof(ReplayRecordHeader)) { return false; }
+
+		ReplayRecordHeader header;
+		memcpy(&header, pPayload, sizeof(ReplayRecordHeader));
+		return size == sizeof(ReplayRecordHeader) + static_cast<uint64_t>(header.m_numMoves) * sizeof(ReplayMove) + static_cast<uint64_t>(header.m_numVisits) * sizeof(ReplayVisit);
+	}
+};
+
+/*!
+	@brief  uploads finished self-play games to the server (stdout of worker) in a background thread
+	        games are sent when ZERO_UPLOAD_BATCH_SIZE games are pending, or every FLUSH_INTERVAL_MS otherwise
+	        push blocks while ZERO_MAX_PENDING_GAMES games are not sent yet, so self-play slows down when
+	        the server stops reading (writing to stdout blocks by the TCP flow control)
+	        SIGTERM (worker.sh kills the previous self-play for each job) is deferred until the frame being written is finished,
+	        otherwise the server reads the following commands as the payload of a truncated frame
+*/
+class SelfPlayUploader {
+	static const int FLUSH_INTERVAL_MS = 1000;
+	static const int FRAME_IDLE = 0;
+	static const int FRAME_WRITING = 1;
+	static const int FRAME_TERMINATE = 2;
+
+private:
+	bool m_bStop;
+	int m_nSending;
+	deque<string> m_qGames;
+	boost::mutex m_mutex;
+	boost::condition_variable m_pushCondition;
+	boost::condition_variable m_uploadCondition;
+	boost::thread m_thread;
+
+public:
+	SelfPlayUploader()
+		: m_bStop(false)
+		, m_nSending(0)
+	{
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = &SelfPlayUploader::handleTerminate;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGTERM, &action, nullptr);
+
+		m_thread = boost::thread(boost::bind(&SelfPlayUploader::run, this));
+	}
+
+	~SelfPlayUploader()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_uploadCondition.notify_one();
+		m_thread.join();
+	}
+
+	void push(const string& sGame)
+	{
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		while (m_qGames.size() + m_nSending >= static_cast<size_t>(max(1, Configure::ZERO_MAX_PENDING_GAMES))) { m_pushCondition.wait(lock); }
+
+		m_qGames.push_back(sGame);
+		if (m_qGames.size() >= static_cast<size_t>(Configure::ZERO_UPLOAD_BATCH_SIZE)) { m_uploadCondition.notify_one(); }
+	}
+
+private:
+	static boost::atomic<int>& getFrameState()
+	{
+		static boost::atomic<int> frameState(FRAME_IDLE);
+		return frameState;
+	}
+
+	// exit at once if no frame is being written, otherwise the writer exits after the frame
+	static void handleTerminate(int signal)
+	{
+		if (getFrameState().exchange(FRAME_TERMINATE) == FRAME_IDLE) { _exit(128 + signal); }
+	}
+
+	void run()
+	{
+		while (true) {
+			vector<string> vGames;
+			{
+				boost::unique_lock<boost::mutex> lock(m_mutex);
+				if (!m_bStop && m_qGames.size() < static_cast<size_t>(Configure::ZERO_UPLOAD_BATCH_SIZE)) {
+					m_uploadCondition.timed_wait(lock, boost::posix_time::milliseconds(FLUSH_INTERVAL_MS));
+				}
+				if (m_qGames.empty()) {
+					if (m_bStop) { return; }
+					continue;
+				}
+
+				int numGames = min(static_cast<int>(m_qGames.size()), max(1, Configure::ZERO_UPLOAD_BATCH_SIZE));
+				vGames.assign(m_qGames.begin(), m_qGames.begin() + numGames);
+				m_qGames.erase(m_qGames.begin(), m_qGames.begin() + numGames);
+				m_nSending = numGames;
+			}
+
+			// games are still counted as pending until written
+			string sFrame = SelfPlayBatch::encode(vGames);
+			int frameState = FRAME_IDLE;
+			if (!getFrameState().compare_exchange_strong(frameState, FRAME_WRITING)) { return; }
+			cout.write(sFrame.data(), sFrame.length());
+			cout.flush();
+			frameState = FRAME_WRITING;
+			if (!getFrameState().compare_exchange_strong(frameState, FRAME_IDLE)) { _exit(128 + SIGTERM); }
+
+			{
+				boost::lock_guard<boost::mutex> lock(m_mutex);
+				m_nSending = 0;
+			}
+			m_pushCondition.notify_all();
+		}
+	}
+};
@@ -54,6 +54,16 @@ public:
 		@param  data [in] the statistic data
 	*/
 	inline void remove ( const StatisticData& data ) ;
+	/*!
+		@brief  add virtual loss for a simulation which is not backed up yet
+		@param  weight [in] number of virtual losses
+	*/
+	inline void addVirtualLoss ( int weight = 1 ) ;
+	/*!
+		@brief  remove virtual loss added by addVirtualLoss
+		@param  weight [in] number of virtual losses
+	*/
+	inline void removeVirtualLoss ( int weight = 1 ) ;
 	/*!
 		@brief  reset by given value
 		@author T.F. Liao
@@ -74,6 +84,19 @@ public:
 		@return count of statistic data as float
 	*/
 	inline data_type getCount () const ;
+	/*!
+		@brief  get number of virtual losses
+		@return number of virtual losses
+	*/
+	inline int getVirtualLoss () const ;
+	/*!
+		@brief  lock the data, for reading mean, count and virtual loss consistently
+	*/
+	inline void lock () ;
+	/*!
+		@brief  unlock the data locked by lock
+	*/
+	inline void unlock () ;
 
 	std::string toString(bool displayInPercentage = false) const {
 		std::ostringstream oss ;
@@ -85,6 +108,7 @@ public:
 private:
 	volatile data_type m_mean ;
 	volatile data_type m_count ;
+	volatile int m_virtualLoss ;
 	SpinLock m_lock;
 };
 
@@ -93,20 +117,23 @@ inline StatisticData::StatisticData ()
 	reset();
 }
 inline StatisticData::StatisticData ( data_type mean, data_type count ) 
-	: m_mean ( mean ), m_count ( count )
+	: m_mean ( mean ), m_count ( count ), m_virtualLoss ( 0 )
 {
 }
 
 inline void StatisticData::add ( data_type val, data_type weight ) 
 {
-	if( weight+m_count <= 0 ) reset();
-	else {
-		m_lock.lock();
+	// check count inside the lock, other threads may change it at the same time
+	m_lock.lock();
+	if( weight+m_count <= 0 ) {
+		m_mean = 0 ;
+		m_count = 0 ;
+	} else {
 		m_count += weight ;
 		val -= m_mean;
 		m_mean +=  weight * val / m_count ;
-		m_lock.unlock();
 	}
+	m_lock.unlock();
 }
 
 inline void StatisticData::add ( const StatisticData& data ) 
@@ -116,13 +143,15 @@ inline void StatisticData::add ( const StatisticData& data )
 
 inline void StatisticData::remove ( data_type val, data_type weight ) 
 {
-	if ( m_count - weight <= 0 ) reset() ;
-	else {
-		m_lock.lock();
+	m_lock.lock();
+	if ( m_count - weight <= 0 ) {
+		m_mean = 0 ;
+		m_count = 0 ;
+	} else {
 		m_count -= weight ;
 		m_mean += weight * (m_mean - val) / m_count;
-		m_lock.unlock();
 	}
+	m_lock.unlock();
 }
 
 inline void StatisticData::remove ( const StatisticData& data ) 
@@ -135,6 +164,21 @@ inline void StatisticData::reset ( data_type mean, data_type count )
 	m_lock.lock();
 	m_mean = mean ;
 	m_count = count ;
+	m_virtualLoss = 0 ;
+	m_lock.unlock();
+}
+
+inline void StatisticData::addVirtualLoss ( int weight ) 
+{
+	m_lock.lock();
+	m_virtualLoss += weight ;
+	m_lock.unlock();
+}
+
+inline void StatisticData::removeVirtualLoss ( int weight ) 
+{
+	m_lock.lock();
+	m_virtualLoss = (m_virtualLoss > weight) ? m_virtualLoss - weight : 0 ;
 	m_lock.unlock();
 }
 
@@ -147,3 +191,18 @@ inline StatisticData::data_type StatisticData::getCount () const
 {
 	return m_count;
 }
+
+inline int StatisticData::getVirtualLoss () const 
+{
+	return m_virtualLoss;
+}
+
+inline void StatisticData::lock () 
+{
+	m_lock.lock();
+}
+
+inline void StatisticData::unlock () 
+{
+	m_lock.unlock();
+}
@@ -2,6 +2,7 @@
 
 #include "Configure.h"
 #include "StatisticData.h"
+#include "ValueBoundTracker.h"
 
 enum SOLUTION_STATUS {
 	SOLUTION_UNKNOWN,
@@ -31,20 +32,51 @@ inline string getSolutionStatusString(SOLUTION_STATUS status) {
 	return "";
 }
 
+/*!
+	@brief  statistics of all children of an expanded node packed in arrays
+	        PUCT selection reads these arrays instead of striding over the children nodes
+*/
+class TreeNodeChildStat {
+public:
+	static const unsigned char FLAG_EXPANDED = 1;
+	static const unsigned char FLAG_SOLVED = 2;
+
+	float* m_pPrior;
+	float* m_pSimCount;
+	float* m_pCount;
+	float* m_pMean;
+	unsigned char* m_pFlag;
+
+	TreeNodeChildStat(float* pData, int nChild)
+		: m_pPrior(pData)
+		, m_pSimCount(pData + nChild)
+		, m_pCount(pData + 2 * nChild)
+		, m_pMean(pData + 3 * nChild)
+		, m_pFlag(reinterpret_cast<unsigned char*>(pData + 4 * nChild))
+	{
+	}
+
+	// four float arrays followed by flags (one byte for each child)
+	static inline int getNumFloat(int nChild) { return 4 * nChild + (nChild + 3) / 4; }
+};
+
 class TreeNode {
 private:
 	Move m_move;
 	int m_nChildren;
-	int m_nBranchingFactor;
-	float m_fValue;
+	SOLUTION_STATUS m_solutionStatus;
 	float m_fProbabilty;
 	float m_fProbabiltyWithNoise;
+	TreeNode* m_pFirstChild;
+	float* m_pChildStat;
+	StatisticData m_uctData;
+
+	// cold fields
+	int m_nBranchingFactor;
+	float m_fValue;
 	HashKey m_hashkey;
 	double m_dProofNumber;
 	double m_dDisproofNumber;
-	StatisticData m_uctData;
-	TreeNode* m_pFirstChild;
-	SOLUTION_STATUS m_solutionStatus;
 
 public:
 	TreeNode() {}
@@ -54,16 +86,17 @@ public:
 	{
 		m_move = move;
 		m_nChildren = 0;
-		m_nBranchingFactor = 0;
-		m_fValue = 0.0f;
+		m_solutionStatus = SOLUTION_UNKNOWN;
 		m_fProbabilty = 0.0f;
 		m_fProbabiltyWithNoise = 0.0f;
+		m_pFirstChild = nullptr;
+		m_pChildStat = nullptr;
+		m_uctData.reset();
+		m_nBranchingFactor = 0;
+		m_fValue = 0.0f;
 		m_hashkey = 0;
 		m_dProofNumber = 0.0f;
 		m_dDisproofNumber = 0.0f;
-		m_uctData.reset();
-		m_pFirstChild = nullptr;
-		m_solutionStatus = SOLUTION_UNKNOWN;
 	}
 
 	inline void setNumChild(int nChild) { m_nChildren = nChild; }
@@ -75,6 +108,7 @@ public:
 	inline void setProofNumber(double pn) { m_dProofNumber = pn; }
 	inline void setDisproofNumber(double dn) { m_dDisproofNumber = dn; }
 	inline void setFirstChild(TreeNode* pFirstChild) { m_pFirstChild = pFirstChild; }
+	inline void setChildStatData(float* pChildStat) { m_pChildStat = pChildStat; }
 	inline void setSolutionStatus(SOLUTION_STATUS status) { m_solutionStatus = status; }
 
 	inline Move getMove() const { return m_move; }
@@ -90,23 +124,40 @@ public:
 	inline StatisticData& getUctData() { return m_uctData; }
 	inline const StatisticData& getUctData() const { return m_uctData; }
 	inline TreeNode* getFirstChild() { return m_pFirstChild; }
+	inline float* getChildStatData() { return m_pChildStat; }
+	inline TreeNodeChildStat getChildStat() { return TreeNodeChildStat(m_pChildStat, m_nChildren); }
 	inline SOLUTION_STATUS getSolutionStatus() const { return m_solutionStatus; }
 
-	inline int getSimCount() const { return m_uctData.getCount(); }
+	inline int getSimCount() const { return m_uctData.getCount() + m_uctData.getVirtualLoss(); }
+
+	// copy the statistics of a child to the packed arrays, it should be called after the child is changed
+	// (copied inside the lock of child, so the last copy is always the latest even if other threads change the child)
+	inline void syncChildStat(TreeNode* pChild) {
+		TreeNodeChildStat childStat = getChildStat();
+		const int index = static_cast<int>(pChild - m_pFirstChild);
+		StatisticData& uctData = pChild->getUctData();
+		uctData.lock();
+		childStat.m_pSimCount[index] = uctData.getCount() + uctData.getVirtualLoss();
+		childStat.m_pCount[index] = uctData.getCount();
+		childStat.m_pMean[index] = uctData.getMean();
+		childStat.m_pFlag[index] = (pChild->hasChildren() ? TreeNodeChildStat::FLAG_EXPANDED : 0)
+			| (pChild->getSolutionStatus() != SOLUTION_UNKNOWN ? TreeNodeChildStat::FLAG_SOLVED : 0);
+		uctData.unlock();
+	}
 	
-	inline float getPUCTValueQ(const map<double, int>& valueMap, float fInitValueQ = -1.0f, Color rootTurn = COLOR_NONE) const {
+	inline float getPUCTValueQ(const ValueBoundTracker& valueBound, float fInitValueQ = -1.0f, Color rootTurn = COLOR_NONE) const {
 		if (Configure::NET_VALUE_WINLOSS) {
-			return (getSimCount() == 0 ? fInitValueQ : getUctData().getMean());
+			return (getSimCount() == 0 ? fInitValueQ : getVirtualLossValueQ(getUctData().getMean()));
 		} else if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
-			if (getSimCount() == 0 || valueMap.empty()) { return fInitValueQ; }
+			if (getSimCount() == 0 || valueBound.empty()) { return fInitValueQ; }
 
 			assert(("Root color should be black or white", (rootTurn == COLOR_BLACK || rootTurn == COLOR_WHITE)));
-			float fValue = getNormalizedValueQ(valueMap, fInitValueQ);
+			float fValue = getNormalizedValueQ(valueBound, fInitValueQ);
 			if (Configure::AOT_PROOF_COLOR == COLOR_NONE) {
-				return (getMove().getColor() == rootTurn) ? -fValue : fValue;
+				return getVirtualLossValueQ((getMove().getColor() == rootTurn) ? -fValue : fValue);
 			} else {
 				// since we want to minimize the space complexity, we should flip the win rate if the color is the same as proof color
-				return (getMove().getColor() == Configure::AOT_PROOF_COLOR) ? -fValue : fValue;
+				return getVirtualLossValueQ((getMove().getColor() == Configure::AOT_PROOF_COLOR) ? -fValue : fValue);
 			}
 		}
 
@@ -114,11 +165,21 @@ public:
 		return fInitValueQ;
 	}
 
-	inline float getNormalizedValueQ(const map<double, int>& valueMap, float fInitValueQ = -1.0f) const {
-		assert(("Value map should not be empty", !valueMap.empty()));
+	// simulations which are not backed up yet (by other threads) are regarded as losses
+	inline float getVirtualLossValueQ(float fValueQ) const {
+		int nVirtualLoss = m_uctData.getVirtualLoss();
+		if (nVirtualLoss == 0) { return fValueQ; }
+
+		float fCount = m_uctData.getCount();
+		return (fValueQ * fCount - nVirtualLoss) / (fCount + nVirtualLoss);
+	}
+
+	inline float getNormalizedValueQ(const ValueBoundTracker& valueBound, float fInitValueQ = -1.0f) const {
+		assert(("Value bound should not be empty", !valueBound.empty()));
 
-		const float fLowerBound = valueMap.begin()->first;
-		const float fUpperBound = valueMap.rbegin()->first;
+		const ValueBoundTracker::Bound bound = valueBound.getBound();
+		const float fLowerBound = bound.m_fLower;
+		const float fUpperBound = bound.m_fUpper;
 
 		float fValue = m_uctData.getMean();
 		float fDistance = fUpperBound - fLowerBound;
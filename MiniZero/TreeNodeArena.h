@@ -0,0 +1,80 @@
+#pragma once
+
+#include "TreeNode.h"
+
+/*!
+	@brief  chunked allocator, chunks are allocated on demand and kept after clear()
+	        elements never move, so pointers to allocated elements stay valid until clear()
+*/
+template<class _element> class ChunkAllocator {
+	static const int CHUNK_SIZE = 1 << 14;
+
+private:
+	size_t m_chunkIndex;
+	int m_chunkUsedIndex;
+	long long m_nUsed;
+	vector<pair<_element*, int>> m_vChunks;
+
+public:
+	ChunkAllocator()
+		: m_chunkIndex(0)
+		, m_chunkUsedIndex(0)
+		, m_nUsed(0)
+	{
+	}
+
+	~ChunkAllocator()
+	{
+		for (size_t i = 0; i < m_vChunks.size(); ++i) { delete[] m_vChunks[i].first; }
+	}
+
+	// size elements are contiguous
+	_element* allocate(int size)
+	{
+		while (m_chunkIndex < m_vChunks.size() && m_chunkUsedIndex + size > m_vChunks[m_chunkIndex].second) {
+			++m_chunkIndex;
+			m_chunkUsedIndex = 0;
+		}
+
+		if (m_chunkIndex == m_vChunks.size()) {
+			int chunkSize = max(CHUNK_SIZE, size);
+			m_vChunks.push_back({ new _element[chunkSize], chunkSize });
+		}
+
+		_element* pElement = m_vChunks[m_chunkIndex].first + m_chunkUsedIndex;
+		m_chunkUsedIndex += size;
+		m_nUsed += size;
+		return pElement;
+	}
+
+	inline void clear()
+	{
+		m_chunkIndex = 0;
+		m_chunkUsedIndex = 0;
+		m_nUsed = 0;
+	}
+
+	inline long long getNumUsed() const { return m_nUsed; }
+};
+
+/*!
+	@brief  allocator of tree nodes and their packed children statistics
+*/
+class TreeNodeArena {
+private:
+	ChunkAllocator<TreeNode> m_nodes;
+	ChunkAllocator<float> m_childStats;
+
+public:
+	// size nodes are contiguous (children of a node are accessed by pointer increment)
+	inline TreeNode* allocate(int size) { return m_nodes.allocate(size); }
+	inline float* allocateChildStat(int nChild) { return m_childStats.allocate(TreeNodeChildStat::getNumFloat(nChild)); }
+
+	inline void clear()
+	{
+		m_nodes.clear();
+		m_childStats.clear();
+	}
+
+	inline long long getNumUsed() const { return m_nodes.getNumUsed(); }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include "boost/atomic.hpp"
+
+/*!
+	@brief  lower and upper bound of a multiset of values (mean of each simulated node)
+	        values are kept in a min heap and a max heap, removed values are kept in another heap of
+	        each side and deleted when both tops are the same, so the bounds are always on the tops
+	        heaps are rebuilt when most of their values are removed
+	        add and update should be serialized, bounds and size can be read by other threads without lock
+*/
+class ValueBoundTracker {
+	static const int MIN_REBUILD_SIZE = 1024;
+
+public:
+	class Bound {
+	public:
+		float m_fLower;
+		float m_fUpper;
+	};
+
+private:
+	boost::atomic<int> m_nValue;
+	boost::atomic<Bound> m_bound; // snapshot of the tops, lower and upper bound are always read together
+	std::vector<double> m_vMinHeap;
+	std::vector<double> m_vMinRemoved;
+	std::vector<double> m_vMaxHeap;
+	std::vector<double> m_vMaxRemoved;
+
+public:
+	ValueBoundTracker() : m_nValue(0), m_bound(Bound()) {}
+
+	inline void clear()
+	{
+		m_nValue = 0;
+		m_vMinHeap.clear();
+		m_vMinRemoved.clear();
+		m_vMaxHeap.clear();
+		m_vMaxRemoved.clear();
+	}
+
+	inline bool empty() const { return m_nValue.load(boost::memory_order_acquire) == 0; }
+	inline int size() const { return m_nValue.load(boost::memory_order_acquire); }
+	inline Bound getBound() const { return m_bound.load(boost::memory_order_acquire); }
+	inline double getLowerBound() const { return getBound().m_fLower; }
+	inline double getUpperBound() const { return getBound().m_fUpper; }
+
+	inline void add(double dValue)
+	{
+		push(m_vMinHeap, dValue, std::greater<double>());
+		push(m_vMaxHeap, dValue, std::less<double>());
+		publishBound();
+		m_nValue.fetch_add(1, boost::memory_order_release);
+	}
+
+	// dOldValue should be added before
+	inline void update(double dOldValue, double dValue)
+	{
+		if (dOldValue == dValue) { return; }
+
+		add(dValue);
+		push(m_vMinRemoved, dOldValue, std::greater<double>());
+		push(m_vMaxRemoved, dOldValue, std::less<double>());
+		m_nValue.fetch_sub(1, boost::memory_order_release);
+
+		removeTop(m_vMinHeap, m_vMinRemoved, std::greater<double>());
+		removeTop(m_vMaxHeap, m_vMaxRemoved, std::less<double>());
+		publishBound();
+		const size_t nValue = static_cast<size_t>(size());
+		if (m_vMinHeap.size() > MIN_REBUILD_SIZE && m_vMinHeap.size() > 2 * nValue) { rebuild(m_vMinHeap, m_vMinRemoved, std::greater<double>()); }
+		if (m_vMaxHeap.size() > MIN_REBUILD_SIZE && m_vMaxHeap.size() > 2 * nValue) { rebuild(m_vMaxHeap, m_vMaxRemoved, std::less<double>()); }
+	}
+
+private:
+	inline void publishBound()
+	{
+		Bound bound;
+		bound.m_fLower = static_cast<float>(m_vMinHeap.front());
+		bound.m_fUpper = static_cast<float>(m_vMaxHeap.front());
+		m_bound.store(bound, boost::memory_order_release);
+	}
+
+	template<class _compare> static inline void push(std::vector<double>& vHeap, double dValue, _compare compare)
+	{
+		vHeap.push_back(dValue);
+		std::push_heap(vHeap.begin(), vHeap.end(), compare);
+	}
+
+	template<class _compare> static inline void removeTop(std::vector<double>& vHeap, std::vector<double>& vRemoved, _compare compare)
+	{
+		while (!vRemoved.empty() && vHeap.front() == vRemoved.front()) {
+			std::pop_heap(vHeap.begin(), vHeap.end(), compare);
+			vHeap.pop_back();
+			std::pop_heap(vRemoved.begin(), vRemoved.end(), compare);
+			vRemoved.pop_back();
+		}
+	}
+
+	template<class _compare> static void rebuild(std::vector<double>& vHeap, std::vector<double>& vRemoved, _compare compare)
+	{
+		std::vector<double> vValue;
+		std::sort(vHeap.begin(), vHeap.end());
+		std::sort(vRemoved.begin(), vRemoved.end());
+		std::set_difference(vHeap.begin(), vHeap.end(), vRemoved.begin(), vRemoved.end(), std::back_inserter(vValue));
+		vHeap.swap(vValue);
+		vRemoved.clear();
+		std::make_heap(vHeap.begin(), vHeap.end(), compare);
+	}
+};
@@ -133,13 +133,18 @@ void ZeroMCTS::handleEndGame()
 {
 	assert(("Calling handleEndGame without meeting end game", isEndGame()));
 
-	boost::lock_guard<boost::mutex> lock(m_mutex);
 	int total_moves = m_game.getMoves().size();
 	map<string, string> mTag;
 	mTag["EV"] = Configure::MACHINE_NAME + ";" + m_network->getModelName();
 	mTag["DT"] = TimeSystem::getTimeString("Y/m/d_H:i:s.f");
 	mTag["RE"] = string{colorToChar(m_game.eval())};
-	cout << "Self-play " << total_moves << " " << m_game.getGameRecord(mTag, Game::getBoardSize()) << endl;
+	string sGameRecord = to_string(total_moves) + " " + m_game.getGameRecord(mTag, Game::getBoardSize());
+	if (m_pUploader) {
+		m_pUploader->push(sGameRecord);
+	} else {
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		cout << "Self-play " << sGameRecord << endl;
+	}
 	newGame();
 }
 
@@ -184,9 +189,9 @@ string ZeroMCTS::getMoveCommentDetail(TreeNode* pSelected)
 	Color rootTurn = AgainstColor(getRootNode()->getMove().getColor());
 
 	oss << "@";
-	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << "Value Bound: (" << m_valueMap.begin()->first << "," << m_valueMap.rbegin()->first << ")@"; }
-	oss << "Root: " << pRoot->getPUCTValueQ(m_valueMap, -1, rootTurn) << "/" << pRoot->getSimCount() << "@";
-	oss << "Selected: " << pSelected->getPUCTValueQ(m_valueMap, -1, rootTurn) << "/" << pSelected->getSimCount() << "@";
+	if (Configure::NET_VALUE_SPACE_COMPLEXITY) { oss << "Value Bound: (" << m_valueBound.getLowerBound() << "," << m_valueBound.getUpperBound() << ")@"; }
+	oss << "Root: " << pRoot->getPUCTValueQ(m_valueBound, -1, rootTurn) << "/" << pRoot->getSimCount() << "@";
+	oss << "Selected: " << pSelected->getPUCTValueQ(m_valueBound, -1, rootTurn) << "/" << pSelected->getSimCount() << "@";
 	oss << "Sequence: " << getBestSequenceString(pSelected) << "@";
 
 	float fBestScore = -DBL_MAX;
@@ -206,7 +211,7 @@ string ZeroMCTS::getMoveCommentDetail(TreeNode* pSelected)
 		float fValueU = fPUCTBias * fValuePa * sqrt(nParentSimulation) / (1 + pChild->getSimCount());
 
 		// Q(s,a)
-		float fValueQ = pChild->getPUCTValueQ(m_valueMap, fInitQValue, rootTurn);
+		float fValueQ = pChild->getPUCTValueQ(m_valueBound, fInitQValue, rootTurn);
 
 		float fMoveScore = fValueU + Configure::MCTS_Q_WEIGHT * fValueQ;
 		oss << left << setw(4) << pChild->getMove().toGtpString(Game::getBoardSize()) << " "	// move
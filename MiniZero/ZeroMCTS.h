@@ -4,12 +4,14 @@
 #include "Network.h"
 #include <boost/thread.hpp>
 #include "Random.h"
+#include "SelfPlayUploader.h"
 
 class ZeroMCTS : public BaseMCTS {
 private:
 	bool m_bDisplay;
 	Network* m_network;
 	boost::mutex& m_mutex;
+	SelfPlayUploader* m_pUploader;
 	
 	const int BATCH_ID;
 
@@ -17,6 +19,7 @@ public:
 	ZeroMCTS(int batchID, boost::mutex& threadMutex)
 		: BATCH_ID(batchID)
 		, m_mutex(threadMutex)
+		, m_pUploader(nullptr)
 		, m_bDisplay(false)
 	{
 	}
@@ -30,6 +33,7 @@ public:
 
 	inline void setDisplay(bool bDisplay) { m_bDisplay = bDisplay; }
 	inline void setNetwork(Network* network) { m_network = network; }
+	inline void setUploader(SelfPlayUploader* pUploader) { m_pUploader = pUploader; }
 
 private:
 	void calculateFeatureAndAddToNet();
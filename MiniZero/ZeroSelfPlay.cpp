@@ -3,15 +3,24 @@
 
 void ZeroSelfPlaySlave::doSlaveJob()
 {
-	if (m_network == nullptr) {
-		int gameIndex = -1;
-		while ((gameIndex = m_sharedData.getNextMCTSIndex()) != -1) {
-			ZeroMCTS* zeroMCTS = m_sharedData.m_vZeroMCTS[gameIndex];
-			zeroMCTS->runMCTSSimulationAfterForward();
-			zeroMCTS->runMCTSSimulationBeforeForward();
+	// slaves stay in this loop after the first startRun, each step is started by m_step
+	unsigned int step = 0;
+	while (!isOver()) {
+		step = m_sharedData.waitNextStep(step);
+
+		if (m_id >= m_sharedData.getNumGPU()) {
+			int gameIndex = -1;
+			const int group = m_sharedData.getMCTSGroup();
+			while ((gameIndex = m_sharedData.getNextMCTSIndex()) != -1) {
+				ZeroMCTS* zeroMCTS = m_sharedData.getZeroMCTS(group, gameIndex);
+				zeroMCTS->runMCTSSimulationAfterForward();
+				zeroMCTS->runMCTSSimulationBeforeForward();
+			}
+		} else {
+			m_sharedData.getNetwork(m_sharedData.m_forwardGroup, m_id).forward();
 		}
-	} else {
-		m_network->forward();
+
+		m_sharedData.finishStep();
 	}
 }
 
@@ -19,14 +28,13 @@ void ZeroSelfPlaySlave::initialize()
 {
 	BaseSlave::initialize();
 
-	if (m_id >= m_sharedData.m_vNetwork.size()) {
+	if (m_id >= m_sharedData.getNumGPU()) {
 		m_bIsInitialize = true;
 		return;
 	}
 
 	// initialize GPU
-	m_sharedData.m_vNetwork[m_id].initialize();
-	m_network = &m_sharedData.m_vNetwork[m_id];
+	for (int group = 0; group < ZeroSelfPlayMSSharedData::NUM_PIPELINE_GROUP; ++group) { m_sharedData.getNetwork(group, m_id).initialize(); }
 	m_bIsInitialize = true;
 }
 
@@ -41,28 +49,24 @@ void ZeroSelfPlayMaster::run()
 {
 	if (!initialize()) { return; }
 
-	const int NUM_GPU = static_cast<int>(Configure::GPU_LIST.length());
-
-	m_sharedData.m_bForwardGPU = false;
+	// GPU threads forward one group while CPU threads run MCTS of the other group, then the groups are swapped
+	// (the first forward of each group has no selected leaf, its result is ignored by runMCTSSimulationAfterForward)
+	m_sharedData.m_forwardGroup = 0;
+	m_sharedData.m_nSlave = m_nThread;
+	for (int i = 0; i < m_nThread; i++) { m_vSlaves[i]->startRun(); }
 	while (true) {
-		m_sharedData.m_mctsIndex = 0;
-
-		if (m_sharedData.m_bForwardGPU) {
-			for (int i = 0; i < NUM_GPU; i++) { m_vSlaves[i]->startRun(); }
-			for (int i = 0; i < NUM_GPU; i++) { m_vSlaves[i]->finishRun(); }
-		} else {
-			for (int i = NUM_GPU; i < m_nThread; i++) { m_vSlaves[i]->startRun(); }
-			for (int i = NUM_GPU; i < m_nThread; i++) { m_vSlaves[i]->finishRun(); }
-		}
-
-		m_sharedData.m_bForwardGPU = !m_sharedData.m_bForwardGPU;
+		m_sharedData.startNextStep();
+		m_sharedData.waitAllSlavesFinished();
+		m_sharedData.m_forwardGroup = m_sharedData.getMCTSGroup();
 	}
 }
 
 bool ZeroSelfPlayMaster::initialize()
 {
-	for (int i = 0; i < static_cast<int>(Configure::GPU_LIST.length()); ++i) {
-		m_sharedData.m_vNetwork.push_back(Network(Configure::GPU_LIST[i] - '0', Configure::MODEL_FILE));
+	for (int group = 0; group < ZeroSelfPlayMSSharedData::NUM_PIPELINE_GROUP; ++group) {
+		for (int i = 0; i < static_cast<int>(Configure::GPU_LIST.length()); ++i) {
+			m_sharedData.m_vNetwork.push_back(Network(Configure::GPU_LIST[i] - '0', Configure::MODEL_FILE));
+		}
 	}
 	if (!BaseMaster::initialize()) { return false; }
 	
@@ -71,14 +75,17 @@ bool ZeroSelfPlayMaster::initialize()
 		while (!m_vSlaves[i]->isInitialize()) { boost::this_thread::sleep(boost::posix_time::milliseconds(100)); }
 	}
 
-	// allocate number of batch size games
-	for (int i = 0; i < static_cast<int>(Configure::GPU_LIST.length()); ++i) {
-		for (int batchID = 0; batchID < Configure::NET_BATCH_SIZE; ++batchID) {
-			ZeroMCTS* zeroMCTS = new ZeroMCTS(batchID, m_sharedData.m_mutex);
-			zeroMCTS->setDisplay(i == 0 && batchID == 0);
-			zeroMCTS->setNetwork(&m_sharedData.m_vNetwork[i]);
-			zeroMCTS->newGame();
-			m_sharedData.m_vZeroMCTS.push_back(zeroMCTS);
+	// allocate number of batch size games for each group
+	for (int group = 0; group < ZeroSelfPlayMSSharedData::NUM_PIPELINE_GROUP; ++group) {
+		for (int i = 0; i < m_sharedData.getNumGPU(); ++i) {
+			for (int batchID = 0; batchID < Configure::NET_BATCH_SIZE; ++batchID) {
+				ZeroMCTS* zeroMCTS = new ZeroMCTS(batchID, m_sharedData.m_mutex);
+				zeroMCTS->setDisplay(group == 0 && i == 0 && batchID == 0);
+				zeroMCTS->setNetwork(&m_sharedData.getNetwork(group, i));
+				zeroMCTS->setUploader(&m_sharedData.m_uploader);
+				zeroMCTS->newGame();
+				m_sharedData.m_vZeroMCTS.push_back(zeroMCTS);
+			}
 		}
 	}
 
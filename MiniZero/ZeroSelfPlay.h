@@ -1,38 +1,102 @@
 #pragma once
 
 #include "Network.h"
+#include <boost/atomic.hpp>
 #include "ZeroMCTS.h"
 #include "Configure.h"
 #include "TimeSystem.h"
 #include "BaseMasterSlave.h"
 
+/*!
+	@brief  games are split into two groups, each GPU has a network (batch) for each group
+	        GPU threads forward one group while CPU threads run MCTS of the other group
+	        master starts a step by increasing m_step, slaves report by m_nFinishedSlave (no barrier)
+	        waiting threads spin for a short time first, then sleep on a condition variable
+*/
 class ZeroSelfPlayMSSharedData {
 public:
-	int m_mctsIndex;
-	bool m_bForwardGPU;
+	static const int NUM_PIPELINE_GROUP = 2;
+	static const int MAX_SPIN_COUNT = 1000;
+
+	boost::atomic<int> m_mctsIndex;
+	boost::atomic<int> m_nFinishedSlave;
+	boost::atomic<unsigned int> m_step;
+	int m_nSlave;
+	int m_forwardGroup;
 	boost::mutex m_mutex;
+	boost::mutex m_stepMutex;
+	boost::condition_variable m_stepStartCondition;
+	boost::condition_variable m_stepFinishCondition;
+	SelfPlayUploader m_uploader;
 	vector<Network> m_vNetwork;
 	vector<ZeroMCTS*> m_vZeroMCTS;
 
+	ZeroSelfPlayMSSharedData()
+		: m_mctsIndex(0)
+		, m_nFinishedSlave(0)
+		, m_step(0)
+		, m_nSlave(0)
+		, m_forwardGroup(0)
+	{
+	}
+
 	inline int getNextMCTSIndex() {
-		boost::lock_guard<boost::mutex> lock(m_mutex);
+		int max_batch_size = getNumGPU() * Configure::NET_BATCH_SIZE;
+		int index = m_mctsIndex.fetch_add(1, boost::memory_order_relaxed);
+		return (index < max_batch_size) ? index : -1;
+	}
+
+	inline void startNextStep() {
+		m_mctsIndex.store(0, boost::memory_order_relaxed);
+		m_nFinishedSlave.store(0, boost::memory_order_relaxed);
+		m_step.fetch_add(1, boost::memory_order_release);
+		// the lock makes sure a slave is either before its check or already waiting
+		{ boost::lock_guard<boost::mutex> lock(m_stepMutex); }
+		m_stepStartCondition.notify_all();
+	}
 
-		int max_batch_size = m_vNetwork.size() * Configure::NET_BATCH_SIZE;
-		if (m_mctsIndex >= max_batch_size) { return -1; }
-		return m_mctsIndex++;
+	inline unsigned int waitNextStep(unsigned int step) {
+		unsigned int nextStep;
+		for (int i = 0; i < MAX_SPIN_COUNT; ++i) {
+			if ((nextStep = m_step.load(boost::memory_order_acquire)) != step) { return nextStep; }
+			boost::this_thread::yield();
+		}
+
+		boost::unique_lock<boost::mutex> lock(m_stepMutex);
+		while ((nextStep = m_step.load(boost::memory_order_acquire)) == step) { m_stepStartCondition.wait(lock); }
+		return nextStep;
+	}
+
+	inline void finishStep() {
+		if (m_nFinishedSlave.fetch_add(1, boost::memory_order_acq_rel) + 1 < m_nSlave) { return; }
+		{ boost::lock_guard<boost::mutex> lock(m_stepMutex); }
+		m_stepFinishCondition.notify_one();
 	}
+
+	inline void waitAllSlavesFinished() {
+		for (int i = 0; i < MAX_SPIN_COUNT; ++i) {
+			if (m_nFinishedSlave.load(boost::memory_order_acquire) >= m_nSlave) { return; }
+			boost::this_thread::yield();
+		}
+
+		boost::unique_lock<boost::mutex> lock(m_stepMutex);
+		while (m_nFinishedSlave.load(boost::memory_order_acquire) < m_nSlave) { m_stepFinishCondition.wait(lock); }
+	}
+
+	inline int getNumGPU() const { return static_cast<int>(m_vNetwork.size()) / NUM_PIPELINE_GROUP; }
+	inline int getMCTSGroup() const { return (m_forwardGroup + 1) % NUM_PIPELINE_GROUP; }
+	inline Network& getNetwork(int group, int gpuID) { return m_vNetwork[group * getNumGPU() + gpuID]; }
+	inline ZeroMCTS* getZeroMCTS(int group, int index) { return m_vZeroMCTS[group * getNumGPU() * Configure::NET_BATCH_SIZE + index]; }
 };
 
 class ZeroSelfPlaySlave : public BaseSlave<ZeroSelfPlayMSSharedData> {
 private:
 	bool m_bIsInitialize;
-	Network* m_network;
 
 public:
 	ZeroSelfPlaySlave(int id, ZeroSelfPlayMSSharedData& sharedData)
 		: BaseSlave(id, sharedData)
 		, m_bIsInitialize(false)
-		, m_network(nullptr)
 	{
 	}
 
@@ -1,19 +1,27 @@
 #include "ZeroServer.h"
 #include "SgfLoader.h"
+#include "ReplayBuffer.h"
+#include "SelfPlayUploader.h"
 #include "TimeSystem.h"
 #include <boost/algorithm/string.hpp>
 
-string ZeroWorkerSharedData::getOneSelfPlay()
+pair<string, string> ZeroWorkerSharedData::getOneSelfPlay()
 {
 	boost::lock_guard<boost::mutex> lock(m_mutex);
-	if (m_selfPlayQueue.empty()) { return ""; }
+	if (m_selfPlayQueue.empty()) { return { "", "" }; }
 	else {
-		string sSelfPlay = m_selfPlayQueue.front();
+		pair<string, string> selfPlay = m_selfPlayQueue.front();
 		m_selfPlayQueue.pop_front();
-		return sSelfPlay;
+		return selfPlay;
 	}
 }
 
+void ZeroWorkerSharedData::clearSelfPlay()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_selfPlayQueue.clear();
+}
+
 bool ZeroWorkerSharedData::isOptimizationDone()
 {
 	boost::lock_guard<boost::mutex> lock(m_mutex);
@@ -33,8 +41,9 @@ void ZeroWorkerStatus::handle_msg(const std::string msg)
 	boost::split(vArgs, msg, boost::is_any_of(" "), boost::token_compress_on);
 
 	if (vArgs[0] == "Info") {
-		// Info name num_gpu type
+		// Info name type
 		m_sName = vArgs[1];
+		if (vArgs.size() >= 3) { m_sType = vArgs[2]; }
 		boost::lock_guard<boost::mutex> lock(m_sharedData.m_workerMutex);
 		m_sharedData.m_fWorkerLog << "[Worker-Connection] "
 			<< TimeSystem::getTimeString("Y/m/d_H:i:s.f ")
@@ -44,7 +53,13 @@ void ZeroWorkerStatus::handle_msg(const std::string msg)
 		if (msg.find("Self-play", msg.find("Self-play", 0) + 1) != string::npos) { return; }
 		string sSelfPlay = msg.substr(msg.find(vArgs[0]) + vArgs[0].length() + 1);
 		boost::lock_guard<boost::mutex> lock(m_sharedData.m_mutex);
-		m_sharedData.m_selfPlayQueue.push_back(sSelfPlay);
+		m_sharedData.m_selfPlayQueue.push_back({ sSelfPlay, "" });
+	} else if (vArgs[0] == SelfPlayBatch::getFrameName() && vArgs.size() == 4) {
+		// Self-play-batch num_games raw_size compressed_size, followed by the compressed games
+		m_bSendFrame = true;
+		m_nPayloadGame = stoi(vArgs[1]);
+		m_payloadRawSize = stoul(vArgs[2]);
+		m_payloadSize = stoul(vArgs[3]);
 	} else if (vArgs[0] == "Optimization_Done") {
 		boost::lock_guard<boost::mutex> lock(m_sharedData.m_mutex);
 		m_sharedData.m_bOptimization = true;
@@ -59,6 +74,28 @@ void ZeroWorkerStatus::handle_msg(const std::string msg)
 	}
 }
 
+void ZeroWorkerStatus::handle_payload(const std::string& payload)
+{
+	vector<pair<string, string>> vGames;
+	if (!SelfPlayBatch::decode(payload, m_payloadRawSize, m_nPayloadGame, vGames)) {
+		std::cerr << "[error] receive broken self-play batch from worker " << m_sName << ", disconnect." << std::endl;
+		do_close();
+		return;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_sharedData.m_mutex);
+	m_sharedData.m_selfPlayQueue.insert(m_sharedData.m_selfPlayQueue.end(), vGames.begin(), vGames.end());
+}
+
+bool ZeroWorkerStatus::isReadPaused()
+{
+	// only back-pressure self-play workers uploading batches, other workers (e.g. optimization) are always read
+	if (m_sType != "sp" || !m_bSendFrame) { return false; }
+
+	boost::lock_guard<boost::mutex> lock(m_sharedData.m_mutex);
+	return m_sharedData.m_selfPlayQueue.size() >= static_cast<size_t>(Configure::ZERO_MAX_PENDING_GAMES);
+}
+
 void ZeroWorkerStatus::do_close()
 {
 	boost::lock_guard<boost::mutex> lock(m_sharedData.m_workerMutex);
@@ -103,10 +140,17 @@ void ZeroServer::initialize()
 void ZeroServer::SelfPlay()
 {
 	// setup
+	m_sharedData.clearSelfPlay();
 	string sSelfPlayGameFileName = Configure::ZERO_TRAIN_DIR + "/sgf/" + to_string(m_iteration) + ".sgf";
 	m_logger.m_fSelfPlayGame.open(sSelfPlayGameFileName.c_str(), ios::out);
 	string sSelfPlayDebugGameFileName = Configure::ZERO_TRAIN_DIR + "/sgf/debug/" + to_string(m_iteration) + ".sgf";
 	m_logger.m_fSelfPlayDebugGame.open(sSelfPlayDebugGameFileName.c_str(), ios::out);
+	string sSelfPlayReplayFileName = Configure::ZERO_TRAIN_DIR + "/replay/" + to_string(m_iteration) + ".bin";
+	m_logger.m_fSelfPlayReplay.open(sSelfPlayReplayFileName.c_str(), ios::out | ios::binary);
+	if (!m_logger.m_fSelfPlayReplay.is_open()) {
+		cerr << "[error] Failed to open " << sSelfPlayReplayFileName << endl;
+		m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[SelfPlay] Failed to open " << sSelfPlayReplayFileName << endl;
+	} else { m_logger.m_fSelfPlayReplay << ReplayRecord::getFileHeaderString(); }
 	m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[Iteration] =====" << m_iteration << "=====" << endl;
 	m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[SelfPlay] Start " << m_sharedData.getModelIteration() << endl;
 
@@ -124,7 +168,8 @@ void ZeroServer::SelfPlay()
 			}
 		}
 
-		string sSelfPlay = m_sharedData.getOneSelfPlay();
+		pair<string, string> selfPlay = m_sharedData.getOneSelfPlay();
+		const string& sSelfPlay = selfPlay.first;
 		if (sSelfPlay == "") {
 			boost::this_thread::sleep(boost::posix_time::milliseconds(100));
 			continue;
@@ -140,6 +185,17 @@ void ZeroServer::SelfPlay()
 
 		m_logger.m_fSelfPlayGame << m_total_games << " " << sMoveNumber << " " << sSimpleSgf << endl;
 		m_logger.m_fSelfPlayDebugGame << m_total_games << " " << sMoveNumber << " " << sSgfString << endl;
+
+		// record binary replay, games sent by batches are converted by workers already
+		SgfLoader sgfLoader;
+		ReplayRecord replayRecord;
+		if (!selfPlay.second.empty()) {
+			m_logger.m_fSelfPlayReplay << selfPlay.second;
+		} else if (sgfLoader.parseFromString(sSimpleSgf) && replayRecord.parseFromSgf(sgfLoader, Game::getBoardSize())) {
+			m_logger.m_fSelfPlayReplay << replayRecord.toBinaryString();
+		} else {
+			m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[SelfPlay] Failed to convert game " << m_total_games << " to replay record" << endl;
+		}
 		++m_total_games;
 
 		// count win/loss/draw & move lengths
@@ -157,6 +213,7 @@ void ZeroServer::SelfPlay()
 
 	m_logger.m_fSelfPlayGame.close();
 	m_logger.m_fSelfPlayDebugGame.close();
+	m_logger.m_fSelfPlayReplay.close();
 
 	// notify selfplay worker
 	{
@@ -166,6 +223,7 @@ void ZeroServer::SelfPlay()
 			worker->write("Job_Done");
 		}
 	}
+	m_sharedData.clearSelfPlay();
 	m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[SelfPlay] Finished." << endl;
 	m_logger.m_fTrainingLog << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ") << "[SelfPlay Win Rate] "
 		<< "Black: " << blackWins * 100.0f / m_total_games << "%"
@@ -220,6 +278,8 @@ string ZeroServer::getSelfPlayConfigure()
 	sConfigure += ":MCTS_SIMULATION_COUNT=" + to_string(Configure::MCTS_SIMULATION_COUNT);
 	sConfigure += ":ZERO_NOISE_EPSILON=" + to_string(Configure::ZERO_NOISE_EPSILON);
 	sConfigure += ":ZERO_NOISE_ALPHA=" + to_string(Configure::ZERO_NOISE_ALPHA);
+	sConfigure += ":ZERO_UPLOAD_BATCH_SIZE=" + to_string(Configure::ZERO_UPLOAD_BATCH_SIZE);
+	sConfigure += ":ZERO_MAX_PENDING_GAMES=" + to_string(Configure::ZERO_MAX_PENDING_GAMES);
 	sConfigure += ":AOT_BRANCHING_FACTOR=" + to_string(Configure::AOT_BRANCHING_FACTOR);
 	sConfigure += ":AOT_PROOF_COLOR=" + string{colorToChar(Configure::AOT_PROOF_COLOR)};
 	
@@ -245,7 +305,7 @@ string ZeroServer::getOptimizationConfigure()
 
 string ZeroServer::deleteUnusedSgfTag(string sSgfString)
 {
-	int end = 0;
+	size_t end = 0;
 	string sNewSgfString = "";
 
 	while ((end = sSgfString.find("*")) != string::npos) {
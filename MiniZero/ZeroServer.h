@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <sys/stat.h>
 #include "Configure.h"
 #include "BaseWorkerHandler.h"
 
@@ -14,14 +15,15 @@ public:
 
 	bool m_bOptimization;
 	int m_modelIteration;
-	std::deque<string> m_selfPlayQueue;
+	std::deque<pair<string, string>> m_selfPlayQueue; // (game, replay record converted by worker, empty if not sent)
 	
 	ZeroWorkerSharedData(boost::mutex& workerMutex, fstream& fWorkerLog)
 		: m_workerMutex(workerMutex), m_fWorkerLog(fWorkerLog)
 	{
 	}
 
-	string getOneSelfPlay();
+	pair<string, string> getOneSelfPlay();
+	void clearSelfPlay();
 	bool isOptimizationDone();
 	int getModelIteration();
 };
@@ -31,6 +33,10 @@ private:
 	bool m_bIdle;
 	string m_sName;
 	string m_sGPUList;
+	string m_sType;
+	bool m_bSendFrame;
+	int m_nPayloadGame;
+	size_t m_payloadRawSize;
 	ZeroWorkerSharedData& m_sharedData;
 
 public:
@@ -38,6 +44,9 @@ public:
 		: BaseWorkerStatus(socket)
 		, m_sharedData(sharedData)
 		, m_bIdle(false)
+		, m_bSendFrame(false)
+		, m_nPayloadGame(0)
+		, m_payloadRawSize(0)
 	{
 	}
 
@@ -48,6 +57,7 @@ public:
 	inline bool isIdle() const { return m_bIdle; }
 	inline string getName() const { return m_sName; }
 	inline string getGPUList() const { return m_sGPUList; }
+	inline string getType() const { return m_sType; }
 	inline void setIdle(bool bIdle) { m_bIdle = bIdle; }
 
 	boost::shared_ptr<ZeroWorkerStatus> shared_from_this()
@@ -56,6 +66,8 @@ public:
 	}
 
 	void handle_msg(const std::string msg);
+	void handle_payload(const std::string& payload);
+	bool isReadPaused();
 	void do_close();
 };
 
@@ -64,6 +76,7 @@ public:
 	fstream m_fWorkerLog;
 	fstream m_fSelfPlayGame;
 	fstream m_fSelfPlayDebugGame;
+	fstream m_fSelfPlayReplay;
 	fstream m_fTrainingLog;
 
 	ZeroLogger() {}
@@ -75,6 +88,9 @@ public:
 		string sTrainingLogFileName = Configure::ZERO_TRAIN_DIR + "/Training.log";
 		m_fTrainingLog.open(sTrainingLogFileName.c_str(), ios::out | ios::app);
 
+		// train directories created before binary replay files have no replay directory
+		mkdir((Configure::ZERO_TRAIN_DIR + "/replay").c_str(), 0755);
+
 		// Separation line
 		for (int i = 0; i < 100; i++) {
 			m_fWorkerLog << "=";
@@ -8,4 +8,5 @@ LEARNING_RATE = 0.02
 MOMENTUM = 0.9
 WEIGHT_DECAY = 0.0001
 NUM_PROCESS = 2
+NUM_SAMPLE_THREAD = 4
 #NUM_PROCESS = 1
\ No newline at end of file
@@ -0,0 +1,32 @@
+import torch
+import torch.nn as nn
+from Network import AlphaZeroWinLoss
+from Network import AlphaZeroSpaceComplexity
+
+import sys
+sys.path.append("/workspace/Release")
+import miniZeroPy
+
+def eprint(*args, **kwargs):
+    print(*args, file=sys.stderr, **kwargs)
+
+if __name__ == '__main__':
+    if len(sys.argv) == 4:
+        trainDir = sys.argv[1]
+        modelFile = sys.argv[2]
+        conf = miniZeroPy.Conf(sys.argv[3])
+    else:
+        eprint("python Quantize.py trainDir modelFile(.pkl) conf_file")
+        exit(0)
+
+    if conf.isTrainWinLoss(): net = AlphaZeroWinLoss(conf.getNNInputChannel(), conf.getNNFilterSize(), conf.getBoardSize(), conf.getMaxNumLegalAction())
+    else: net = AlphaZeroSpaceComplexity(conf.getNNInputChannel(), conf.getNNFilterSize(), conf.getBoardSize(), conf.getMaxNumLegalAction(), conf.getNNNumOuputValue())
+    model = torch.load(trainDir+"/model/"+modelFile, map_location=torch.device('cpu'))
+    net.load_state_dict(model['netWeights'])
+    net.eval()
+
+    # fully connected layers are quantized to int8, convolution layers are kept in fp32 (fused by NET_OPTIMIZE_FOR_INFERENCE)
+    quantizedNet = torch.quantization.quantize_dynamic(net, {nn.Linear}, dtype=torch.qint8)
+    outputFile = trainDir+"/model/"+modelFile.replace(".pkl", "_int8.pt")
+    torch.jit.script(quantizedNet).save(outputFile)
+    eprint("save quantized model "+outputFile)
@@ -19,29 +19,32 @@ def eprint(*args, **kwargs):
     print(*args, file=sys.stderr, **kwargs)
 
 class MiniZeroDataset(IterableDataset):
-    def __init__(self, trainDir, start, end, seed, train_win_loss):
+    def __init__(self, trainDir, start, end, seed, batch_size, train_win_loss):
         self.trainDir = trainDir
         self.start = start
         self.end = end
         self.seed = seed
+        self.batch_size = batch_size
         self.train_win_loss = train_win_loss
     
     def __iter__(self):
-        dataLoader = miniZeroPy.DataLoader(self.trainDir, self.seed + get_worker_info().id)
-        dataLoader.load(self.start, self.end)
+        dataLoader = miniZeroPy.DataLoader(self.trainDir, self.seed + get_worker_info().id * NUM_SAMPLE_THREAD, NUM_SAMPLE_THREAD)
+        if not dataLoader.load(self.start, self.end):
+            raise RuntimeError("failed to load replay buffer")
 
+        # each batch is filled in place by C++ threads, new tensors are allocated since yielded ones are still in use
+        valueSize = 1 if self.train_win_loss else 2 * conf.getNNNumOuputValue()
         while True:
-            dataLoader.calculateFeaturesAndLabels()
-            
-            features = torch.FloatTensor(dataLoader.getFeatures()).view(conf.getNNInputChannel(), conf.getBoardSize(), conf.getBoardSize())
-            policy = torch.FloatTensor(dataLoader.getPolicy())
+            features = torch.empty(self.batch_size, conf.getNNInputChannel(), conf.getBoardSize(), conf.getBoardSize())
+            policy = torch.empty(self.batch_size, conf.getMaxNumLegalAction())
+            value = torch.empty(self.batch_size, valueSize)
+            if not dataLoader.sampleBatch(features.numpy(), policy.numpy(), value.numpy()):
+                raise RuntimeError("failed to sample batch")
+
             if self.train_win_loss:
-                value = torch.FloatTensor([dataLoader.getValueWinLoss()])
                 yield features, policy, value
             else:
-                blackV = torch.FloatTensor(dataLoader.getBlackValue())
-                whiteV = torch.FloatTensor(dataLoader.getWhiteValue())
-                yield features, policy, blackV, whiteV
+                yield features, policy, value[:, :conf.getNNNumOuputValue()], value[:, conf.getNNNumOuputValue():]
 
 def lossOfWinLoss(outputP, outputV, labelP, labelV):
     lossP = -(labelP * nn.functional.log_softmax(outputP, dim=1)).sum() / outputP.shape[0]
@@ -109,8 +112,11 @@ if __name__ == '__main__':
         exit(0)
     
     # create dataset & dataloader
-    dataset = MiniZeroDataset(trainDir, start, end, SEED, conf.isTrainWinLoss())
-    dataloader = DataLoader(dataset, batch_size=TRAIN_BATCH_SIZE, num_workers=NUM_PROCESS)
+    if not miniZeroPy.buildReplayIndex(trainDir, start, end):
+        eprint("failed to build replay index")
+        exit(1)
+    dataset = MiniZeroDataset(trainDir, start, end, SEED, TRAIN_BATCH_SIZE, conf.isTrainWinLoss())
+    dataloader = DataLoader(dataset, batch_size=None, num_workers=NUM_PROCESS)
     dataloaderIter = iter(dataloader)
 
     loss_accumulation = {}
@@ -2,150 +2,199 @@
 #include <pybind11/stl.h>
 #include <cmath>
 #include <random>
-#include <fstream>
-#include "SgfLoader.h"
+#include <thread>
+#include <memory>
+#include "ReplayBuffer.h"
 #include "../MiniZero/Configure.h"
 
 using namespace std;
 namespace py = pybind11;
 
 class DataLoader {
+	// each sampler is only used by one thread
+	class Sampler {
+	public:
+		mt19937 m_gen;
+		uniform_int_distribution<> m_dis;
+
+		Sampler(int seed) : m_gen(seed), m_dis(1, INT_MAX) {}
+		inline int getRandom() { return m_dis(m_gen); }
+	};
+
 public:
-	Game m_game;
-	int m_dataSize;
 	string m_sTrainDir;
-	vector<pair<SgfLoader, int>> m_vGameCollection;
-	
-	// random generator
-	mt19937 m_gen;
-	uniform_int_distribution<> m_dis;
+	ReplayBufferIndex m_replayIndex;
+	vector<unique_ptr<Sampler>> m_vSamplers;
+	vector<vector<int>> m_vFeatureRotation;
 	
 	// feature & label
 	vector<float> m_vFeatures;
 	vector<float> m_vPolicy;
-	float m_fValueWinLoss;
-	vector<float> m_vBlackValue;
-	vector<float> m_vWhiteValue;
+	vector<float> m_vValue;
 	
 	
 public:
-	DataLoader(string sTrainDir, int seed)
+	DataLoader(string sTrainDir, int seed, int numThreads = 1)
 		: m_sTrainDir(sTrainDir)
 	{
-		m_gen = mt19937(seed);
-		m_dis = uniform_int_distribution<>(1, INT_MAX);
+		for (int i = 0; i < max(1, numThreads); ++i) { m_vSamplers.push_back(unique_ptr<Sampler>(new Sampler(seed + i))); }
+		m_vFeatures.resize(getFeatureSize());
+		m_vPolicy.resize(getPolicySize());
+		m_vValue.resize(getValueSize());
+
+		// feature index of each packed SYM_NORMAL feature under each symmetry
+		const int planeSize = Game::getBoardSize() * Game::getBoardSize();
+		m_vFeatureRotation.resize(SYMMETRY_SIZE, vector<int>(getFeatureSize()));
+		for (int type = 0; type < SYMMETRY_SIZE; ++type) {
+			for (int i = 0; i < getFeatureSize(); ++i) {
+				m_vFeatureRotation[type][i] = (i / planeSize) * planeSize + getRotatePosition(i % planeSize, Game::getBoardSize(), static_cast<SymmetryType>(type));
+			}
+		}
 	}
 	
-	void load(int start, int end) {
-		string sgf;
-		SgfLoader sgfLoader;
-		
-		m_dataSize = 0;
-		for(int i=start; i<=end; ++i) {
-			ifstream file(m_sTrainDir + "/sgf/" + to_string(i) + ".sgf", std::ifstream::in);
-			while(getline(file, sgf)) {
-				sgfLoader.parseFromString(sgf);
-				m_dataSize += sgfLoader.getSgfNode().size() - 1;
-				m_vGameCollection.push_back({sgfLoader, m_dataSize});
-			}
+	// the index should be built by buildReplayIndex before, it is mapped read-only and shared by all loaders
+	bool load(int start, int end) {
+		if (!m_replayIndex.open(m_sTrainDir, start, end)) {
+			cerr << "[DataLoader] Failed to open replay index of iteration " << start << " to " << end << endl;
+			return false;
+		} else if (m_replayIndex.getFeatureSize() != getFeatureSize()) {
+			cerr << "[DataLoader] Feature size of replay buffer does not match the game" << endl;
+			return false;
 		}
+		return m_replayIndex.getDataSize() > 0;
 	}
 	
 	void calculateFeaturesAndLabels() {
-		m_game.reset();
-		pair<int, int> p = randomPickPosition();
-		const SgfLoader& sgfLoader = m_vGameCollection[p.first].first;
-		for (int i = 1; i < p.second + 1; ++i) { m_game.play(Move(sgfLoader.getSgfNode()[i].m_move, m_game.getBoardSize())); }
+		calculateFeaturesAndLabels(*m_vSamplers[0], m_vFeatures.data(), m_vPolicy.data(), m_vValue.data());
+	}
+	
+	// fill a batch into C-contiguous float32 buffers (numpy arrays or tensor.numpy()) of shape
+	// features: (n, channels, board size, board size), policy: (n, max legal actions), value: (n, 1) for win-loss or (n, 2 * NET_NUM_OUTPUT_V) for black and white space complexity
+	bool sampleBatch(py::buffer features, py::buffer policy, py::buffer value) {
+		py::buffer_info featuresInfo = features.request(true);
+		py::buffer_info policyInfo = policy.request(true);
+		py::buffer_info valueInfo = value.request(true);
+		if (!isFloatBuffer(featuresInfo) || !isFloatBuffer(policyInfo) || !isFloatBuffer(valueInfo) || featuresInfo.ndim == 0) {
+			cerr << "[DataLoader] sampleBatch needs C-contiguous float32 buffers" << endl;
+			return false;
+		}
 
-		SymmetryType type = static_cast<SymmetryType>(m_dis(m_gen) % SYMMETRY_SIZE);
-		m_vFeatures = m_game.getFeatures(type);
-		calculatePolicy(sgfLoader.getSgfNode()[p.second + 1], type);
+		int batchSize = featuresInfo.shape[0];
+		if (featuresInfo.size != batchSize * getFeatureSize() || policyInfo.size != batchSize * getPolicySize() || valueInfo.size != batchSize * getValueSize()) {
+			cerr << "[DataLoader] sampleBatch buffer sizes do not match batch size " << batchSize << endl;
+			return false;
+		}
+
+		float* pFeatures = static_cast<float*>(featuresInfo.ptr);
+		float* pPolicy = static_cast<float*>(policyInfo.ptr);
+		float* pValue = static_cast<float*>(valueInfo.ptr);
+
+		py::gil_scoped_release release;
+		auto sample = [&](int threadID) {
+			Sampler& sampler = *m_vSamplers[threadID];
+			for (int i = threadID; i < batchSize; i += m_vSamplers.size()) {
+				calculateFeaturesAndLabels(sampler, pFeatures + i * getFeatureSize(), pPolicy + i * getPolicySize(), pValue + i * getValueSize());
+			}
+		};
+
+		vector<thread> vThreads;
+		for (int i = 1; i < m_vSamplers.size(); ++i) { vThreads.push_back(thread(sample, i)); }
+		sample(0);
+		for (auto& t : vThreads) { t.join(); }
+
+		return true;
+	}
+	
+	inline py::list getFeatures() { return py::cast(m_vFeatures); }
+	inline py::list getPolicy() { return py::cast(m_vPolicy); }
+	inline float getValueWinLoss() { return m_vValue[0]; }
+	inline py::list getBlackValue() { return py::cast(vector<float>(m_vValue.begin(), m_vValue.begin() + Configure::NET_NUM_OUTPUT_V)); }
+	inline py::list getWhiteValue() { return py::cast(vector<float>(m_vValue.begin() + Configure::NET_NUM_OUTPUT_V, m_vValue.end())); }
+	
+private:
+	inline int getFeatureSize() const { return Game::getNumChannels() * Game::getBoardSize() * Game::getBoardSize(); }
+	inline int getPolicySize() const { return Game::getMaxNumLegalAction(); }
+	inline int getValueSize() const { return Configure::NET_VALUE_WINLOSS ? 1 : 2 * Configure::NET_NUM_OUTPUT_V; }
+	
+	inline bool isFloatBuffer(const py::buffer_info& info) const {
+		if (info.format != py::format_descriptor<float>::format() || info.itemsize != sizeof(float)) { return false; }
+
+		py::ssize_t stride = info.itemsize;
+		for (int i = info.ndim - 1; i >= 0; --i) {
+			if (info.shape[i] > 1 && info.strides[i] != stride) { return false; }
+			stride *= info.shape[i];
+		}
+		return true;
+	}
+	
+	void calculateFeaturesAndLabels(Sampler& sampler, float* pFeatures, float* pPolicy, float* pValue) {
+		pair<int, int> p = randomPickPosition(sampler);
+		ReplayRecordView record = m_replayIndex.getRecord(p.first);
+
+		SymmetryType type = static_cast<SymmetryType>(sampler.getRandom() % SYMMETRY_SIZE);
+		calculateFeatures(m_replayIndex.getFeatures(p.first, p.second), type, pFeatures);
+		calculatePolicy(record, record.getMove(p.second), type, pPolicy);
 
 		// value
-		Color winner = charToColor(sgfLoader.getTag("RE")[0]);
+		Color winner = record.getResult();
 		if (Configure::NET_VALUE_WINLOSS) {
 			// value (win loss)
-			Color nextColor = charToColor(sgfLoader.getSgfNode()[p.second + 1].m_move.first[0]);
-			m_fValueWinLoss = (winner == COLOR_NONE ? 0.0f : (winner == nextColor ? 1.0f : -1.0f));
-		}
-		
-		if (Configure::NET_VALUE_SPACE_COMPLEXITY) {
+			Color nextColor = static_cast<Color>(record.getMove(p.second).m_color);
+			pValue[0] = (winner == COLOR_NONE ? 0.0f : (winner == nextColor ? 1.0f : -1.0f));
+		} else {
 			// value (space complexity)
 			float fSpaceComplexity = 0.0f;
-			for (int i = static_cast<int>(sgfLoader.getSgfNode().size()) - 2; i >= p.second + 1; i -= 2) {
-				string sComment = sgfLoader.getSgfNode()[i].m_comment;
-				fSpaceComplexity += log10(stoi(sComment.substr(sComment.find("%") + 1)));
+			for (int i = record.getNumMoves() - 2; i >= p.second; i -= 2) {
+				int branchingFactor = record.getMove(i).m_branchingFactor;
+				if (branchingFactor > 0) { fSpaceComplexity += log10(branchingFactor); }
 			}
 			fSpaceComplexity = fmax(0, fmin(fSpaceComplexity, Configure::NET_NUM_OUTPUT_V - 1));
-			setSpaceComplexityValue(m_vBlackValue, (winner == COLOR_BLACK ? fSpaceComplexity : Configure::NET_NUM_OUTPUT_V - 1));
-			setSpaceComplexityValue(m_vWhiteValue, (winner == COLOR_WHITE ? fSpaceComplexity : Configure::NET_NUM_OUTPUT_V - 1));
+			setSpaceComplexityValue(pValue, (winner == COLOR_BLACK ? fSpaceComplexity : Configure::NET_NUM_OUTPUT_V - 1));
+			setSpaceComplexityValue(pValue + Configure::NET_NUM_OUTPUT_V, (winner == COLOR_WHITE ? fSpaceComplexity : Configure::NET_NUM_OUTPUT_V - 1));
 		}
 	}
 	
-	inline py::list getFeatures() { return py::cast(m_vFeatures); }
-	inline py::list getPolicy() { return py::cast(m_vPolicy); }
-	inline float getValueWinLoss() { return m_fValueWinLoss; }
-	inline py::list getBlackValue() { return py::cast(m_vBlackValue); }
-	inline py::list getWhiteValue() { return py::cast(m_vWhiteValue); }
-	
-private:
-	pair<int, int> randomPickPosition() {
+	pair<int, int> randomPickPosition(Sampler& sampler) {
 		int l = 0;
-		int r = m_vGameCollection.size();
-		int randPos = m_dis(m_gen) % m_dataSize;
+		int r = m_replayIndex.getNumRecords();
+		int randPos = sampler.getRandom() % m_replayIndex.getDataSize();
 
 		while(l<r) {
 			int m = l + (r-l)/2;
-			if(randPos>=m_vGameCollection[m].second) { l = m + 1; }
+			if(randPos>=m_replayIndex.getDataSize(m)) { l = m + 1; }
 			else { r = m; }
 		}
 
-		return {l, (l==0? randPos: randPos - m_vGameCollection[l-1].second)};
+		return {l, static_cast<int>(l==0? randPos: randPos - m_replayIndex.getDataSize(l-1))};
 	}
 	
-	std::vector<string> splitToVector(const string& sParam, const char& cToken)
-	{
-		string s;
-		std::vector<string> vArgument;
-		std::istringstream iss(sParam);
-		while( std::getline(iss,s,cToken) ) { vArgument.push_back(s); }
-
-		return vArgument;
+	void calculateFeatures(const uint64_t* pWords, SymmetryType type, float* pFeatures) {
+		fill(pFeatures, pFeatures + getFeatureSize(), 0.0f);
+		const vector<int>& vRotation = m_vFeatureRotation[type];
+		for (int i = 0; i * 64 < getFeatureSize(); ++i) {
+			for (uint64_t word = pWords[i]; word; word &= word - 1) { pFeatures[vRotation[i * 64 + __builtin_ctzll(word)]] = 1.0f; }
+		}
 	}
 	
-	void calculatePolicy(const SgfNode& sgfNode, SymmetryType type) {
-		string sComment = sgfNode.m_comment;
-		m_vPolicy.clear();
-		m_vPolicy.resize(Game::getMaxNumLegalAction(), 0);
-		if(sComment.empty() || sComment[0]=='%') {
-			int pos = Move(sgfNode.m_move, Game::getBoardSize()).getPosition();
-			pos = getRotatePosition(pos, Game::getBoardSize(), type);
-			m_vPolicy[pos] = 1.0f;
+	void calculatePolicy(const ReplayRecordView& record, const ReplayMove& replayMove, SymmetryType type, float* pPolicy) {
+		fill(pPolicy, pPolicy + getPolicySize(), 0.0f);
+		if (replayMove.m_numVisits == 0) {
+			pPolicy[getRotatePosition(replayMove.m_position, Game::getBoardSize(), type)] = 1.0f;
+			return;
 		}
-		
-		// calculate distribution
-		sComment = sComment.substr(0, sComment.find("%"));
-		vector<string> vMoveCount = splitToVector(sComment, ',');
 
+		// calculate distribution
 		float total_count = 0;
-		for (int i = 0; i < vMoveCount.size(); ++i) {
-			if (vMoveCount[i].find(":") == string::npos) { continue; }
-
-			int split_index = static_cast<int>(vMoveCount[i].find(":"));
-			int pos = atoi(vMoveCount[i].substr(0, split_index).c_str());
-			pos = getRotatePosition(pos, Game::getBoardSize(), type);
-			float count = atof(vMoveCount[i].substr(split_index + 1).c_str());
-			m_vPolicy[pos] = count;
-			total_count += count;
+		const ReplayVisit* pVisit = record.getVisits(replayMove);
+		for (int i = 0; i < replayMove.m_numVisits; ++i) { total_count += pVisit[i].m_count; }
+		for (int i = 0; i < replayMove.m_numVisits; ++i) {
+			int pos = getRotatePosition(pVisit[i].m_position, Game::getBoardSize(), type);
+			pPolicy[pos] = pVisit[i].m_count / total_count;
 		}
-
-		// normalization
-		for (int i = 0; i < m_vPolicy.size(); ++i) { m_vPolicy[i] /= total_count; }
 	}
 	
-	void setSpaceComplexityValue(vector<float>& vValue, float fValue) {
-		vValue.clear();
-		vValue.resize(Configure::NET_NUM_OUTPUT_V, 0);
+	void setSpaceComplexityValue(float* pValue, float fValue) {
+		fill(pValue, pValue + Configure::NET_NUM_OUTPUT_V, 0.0f);
 		assert(("NET_NUM_OUTPUT_V should be larger than 1", Configure::NET_NUM_OUTPUT_V > 1));
 
 		float fLowerBound = floor(fValue);
@@ -153,10 +202,10 @@ private:
 
 		if (fLowerBound == fUpperBound) {
 			assert(("Space complexity value should range in [0," + to_string(Configure::NET_NUM_OUTPUT_V) + ")", fLowerBound >= 0 && fLowerBound < Configure::NET_NUM_OUTPUT_V));
-			vValue[fLowerBound] = 1.0f;
+			pValue[static_cast<int>(fLowerBound)] = 1.0f;
 		} else {
-			vValue[fLowerBound] = fUpperBound - fValue;
-			vValue[fUpperBound] = fValue - fLowerBound;
+			pValue[static_cast<int>(fLowerBound)] = fUpperBound - fValue;
+			pValue[static_cast<int>(fUpperBound)] = fValue - fLowerBound;
 		}
 	}
 };
@@ -179,10 +228,13 @@ public:
 
 namespace py = pybind11;
 PYBIND11_MODULE(miniZeroPy, m) {
+	m.def("buildReplayIndex", &ReplayBufferIndex::build<Game, Move>);
+
 	py::class_<DataLoader>(m, "DataLoader")
-		.def(py::init<string, int>())
+		.def(py::init<string, int, int>(), py::arg("trainDir"), py::arg("seed"), py::arg("numThreads") = 1)
 		.def("load", &DataLoader::load)
-		.def("calculateFeaturesAndLabels", &DataLoader::calculateFeaturesAndLabels)
+		.def("calculateFeaturesAndLabels", static_cast<void (DataLoader::*)()>(&DataLoader::calculateFeaturesAndLabels))
+		.def("sampleBatch", &DataLoader::sampleBatch)
 		.def("getFeatures", &DataLoader::getFeatures)
 		.def("getPolicy", &DataLoader::getPolicy)
 		.def("getValueWinLoss", &DataLoader::getValueWinLoss)
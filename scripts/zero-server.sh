@@ -30,6 +30,7 @@ if [[ ${run_stage} == "R" ]]; then
 	mkdir ${TRAIN_DIR}/model
 	mkdir ${TRAIN_DIR}/sgf
 	mkdir ${TRAIN_DIR}/sgf/debug
+	mkdir ${TRAIN_DIR}/replay
 	touch ${TRAIN_DIR}/op.log
 	NEW_CONFIGURE_FILE=$(echo ${TRAIN_DIR} | awk -F "/" '{ print $NF".cfg"; }')
 	cp ${CONFIGURE_FILE} ${TRAIN_DIR}/${NEW_CONFIGURE_FILE}
@@ -40,6 +41,7 @@ elif [[ ${run_stage} == "C" ]]; then
     ZERO_START_ITERATION=$(ls -t ${TRAIN_DIR}/sgf/* | head -n1 | sed 's/.sgf//g' | awk -F "/" '{ print $NF+1; }')
     MODEL_FILE=$(ls -t ${TRAIN_DIR}/model/*.pt | head -n1 | sed 's/\// /g' | awk '{ print $NF; }')
     NEW_CONFIGURE_FILE=$(ls ${TRAIN_DIR}/*.cfg | sed 's/\// /g' | awk '{ print $NF; }')
+    mkdir -p ${TRAIN_DIR}/replay
 else
 	exit
 fi